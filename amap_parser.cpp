@@ -1,18 +1,29 @@
 #include <cstdlib>
+#include <stdexcept>
 #include <string.h>
+#include <ctype.h>
 #include "amap_parser.h"
 
 using std::string;
+using std::vector;
 using std::map;
 
 
+// Thrown when a line of the address map is malformed
+struct malformed_line_t
+{
+    uint32_t column;
+    string   message;
+};
+
+
 //=============================================================================
-// halt() - Display an error messager and exit
+// halt() - Abandons parsing of a malformed address map line.  "where" points
+//          to the problem in the line that starts at "start"
 //=============================================================================
-static void halt()
+static void halt(const char* start, const char* where, const char* message)
 {
-    fprintf(stderr, "xlate_vreg: address map file is malformed\n");
-    exit(1);
+    throw malformed_line_t{uint32_t(where - start + 1), message};
 }
 //=============================================================================
 
@@ -55,7 +66,7 @@ static string get_key_type(const char* start)
     const char* in = strchr(start, '=');
 
     // If there was no '=', give up
-    if (in == nullptr) halt();
+    if (in == nullptr) halt(start, strchr(start, 0), "missing '='");
 
     // From the equal sign, back up until we find text
     while (in > start)
@@ -64,7 +75,7 @@ static string get_key_type(const char* start)
     }
 
     // If we never found text, quit
-    if (in == start) halt();
+    if (in == start) halt(start, start, "missing key before '='");
 
     // This points to the last character of the token we're fetching
     const char* last = in;
@@ -76,7 +87,7 @@ static string get_key_type(const char* start)
     }
 
     // If we never found the '.', quit
-    if (in == start) halt();
+    if (in == start) halt(start, start, "key has no '.'");
 
     // This is how long the token is
     int length = last - in;
@@ -91,6 +102,26 @@ static string get_key_type(const char* start)
 //=============================================================================
 
 
+//=============================================================================
+// get_key_space() - Fetches the address space from the key, which is
+//                   everything before the last "/" of the key.  This must
+//                   only be called once get_key_type() has accepted the line
+//=============================================================================
+static string get_key_space(const char* start)
+{
+    // Find the '.' that ends the segment name
+    const char* in = strchr(start, '=');
+    while (*--in != '.');
+
+    // Back up to the '/' that starts the segment name
+    while (in > start && *in != '/') --in;
+
+    // Everything before that is the address space
+    return string(start, in - start);
+}
+//=============================================================================
+
+
 //=============================================================================
 // get_key_value() - Fetches the quoted token after the =
 //=============================================================================
@@ -102,16 +133,17 @@ static string get_key_value(const char* start)
     const char* in = strchr(start, '=');
 
     // If there was no '=', give up
-    if (in == nullptr) halt();
+    if (in == nullptr) halt(start, strchr(start, 0), "missing '='");
 
     // Now find the opening quotation mark
+    const char* equal = in;
     in = strchr(in+1, 34);
 
     // If there was no double-quote, give up
-    if (in == nullptr) halt();
+    if (in == nullptr) halt(start, equal + 1, "missing quoted value after '='");
 
     // Skip over the opening double-quote
-    ++in;
+    const char* quote = in++;
 
     while (true)
     {
@@ -119,7 +151,7 @@ static string get_key_value(const char* start)
         int c = *in;
         
         // If we hit the end of line, this is malformed
-        if (c == 0) halt();
+        if (c == 0) halt(start, quote, "unterminated quoted value");
 
         // If we hit the closing quote, we're done
         if (c == 34) break;
@@ -141,55 +173,167 @@ static string get_key_value(const char* start)
 
 //=============================================================================
 // parse_address_map() - Parses the output of "parse_xbd" to build a list of
-//                       AXI connection names and their AXI addresses
+//                       AXI connection names and their AXI addresses.
+//
+// If "diag" is given, a malformed line is recorded there and skipped, so
+// that every malformed line gets reported.  Otherwise, the first one throws
 //=============================================================================
-void parse_address_map(string filename, map<string, connection_t>* addrmap)
+void parse_address_map(string filename, map<string, connection_t>* addrmap, CDiagnostics* diag)
 {
     char buffer[10000];
     connection_t entry;
+    uint32_t line = 0;
     
     // Open the input file and complain if we can't
     FILE* ifile = fopen(filename.c_str(), "r");
     if (ifile == nullptr)
     {
-        fprintf(stderr, "xlate_vreg: can't open %s\n", filename.c_str());
-        exit(1);
+        throw std::runtime_error("can't open " + filename);
     }
 
-    // Loop through every line of the input file
-    while (fgets(buffer, sizeof buffer, ifile))
+    // A malformed line throws, and we don't want to leak the file when it does
+    try
     {
-        // Get a pointer to the input line
-        const char* p = buffer;
+        // Loop through every line of the input file
+        while (fgets(buffer, sizeof buffer, ifile))
+        {
+            // Keep track of the line number for reporting problems
+            ++line;
+
+            // Get a pointer to the input line
+            const char* p = buffer;
+
+            // Skip over whitespace
+            while (*p == 32 || *p == 9 || *p == 10 || *p == 13) ++p;
+
+            // If the line is blank, skip it
+            if (*p == 0) continue;
+
+            string key_type, key_value, key_space;
+            try
+            {
+                // The "key_type" is everything after the last "." in the key
+                key_type = get_key_type(p);
+
+                // Fetch the value from this key/value pair
+                key_value = get_key_value(p);
+
+                // Everything before the segment name is the address space
+                key_space = get_key_space(p);
+            }
+            catch (const malformed_line_t& e)
+            {
+                diagnostic_t d = {filename, line, uint32_t(e.column + (p - buffer)), e.message};
+                if (diag == nullptr) throw std::runtime_error(format_diagnostic(d));
+                diag->error(d.file, d.line, d.column, d.message);
+                continue;
+            }
+
+            // On an "address_block", we just memorize the name of the connection
+            if (key_type == "address_block")
+            {
+                entry.name = chopped(key_value);
+                continue;
+            }
+
+            // On an "offset" block, we save this entry
+            if (key_type == "offset")
+            {
+                entry.address = strtoull(key_value.c_str(), nullptr, 0);
+                entry.space   = key_space;
+                entry.line    = line;
+                (*addrmap)[connection_key(entry.space, entry.name)] = entry;
+            }
+        }
+    }
+    catch(...)
+    {
+        fclose(ifile);
+        throw;
+    }
 
-        // Skip over whitespace
-        while (*p == 32 || *p == 9 || *p == 10 || *p == 13) ++p;
+    // Close the input file, we're done
+    fclose(ifile);
+}
+//=============================================================================
 
-        // If the line is blank, skip it
-        if (*p == 0) continue;
 
-        // The "key_type" is everything after the last "." in the key
-        string key_type = get_key_type(p);
+//=============================================================================
+// connection_key() - Returns the key of a connection in an address map.  The
+//                    same connection can be seen in more than one address
+//                    space, so the key is made of both
+//=============================================================================
+string connection_key(const string& space, const string& name)
+{
+    return space + '\n' + name;
+}
+//=============================================================================
 
-        // Fetch the value from this key/value pair
-        string key_value = get_key_value(p);
 
-        // On an "address_block", we just memorize the name of the connection
-        if (key_type == "address_block")
-        {
-            entry.name = chopped(key_value);
-            continue;
-        }
+//=============================================================================
+// address_spaces() - Returns the address spaces in an address map
+//=============================================================================
+vector<string> address_spaces(const map<string, connection_t>& addrmap)
+{
+    vector<string> result;
 
-        // On an "offset" block, we save this entry
-        if (key_type == "offset")
-        {
-            entry.address = strtoull(key_value.c_str(), nullptr, 0);
-            (*addrmap)[entry.name] = entry;
-        }
+    // Connections are sorted by address space, so each space is a single run
+    for (auto& c : addrmap)
+    {
+        if (result.empty() || result.back() != c.second.space) result.push_back(c.second.space);
     }
 
-    // Close the input file, we're done
-    fclose(ifile);
+    return result;
 }
-//=============================================================================
\ No newline at end of file
+//=============================================================================
+
+
+//=============================================================================
+// connection_ident() - Returns the C identifier that names a connection.
+//                      This is the connection prefix, or if there is no 
+//                      prefix, it's derived from the connection name
+//=============================================================================
+string connection_ident(const connection_t& conn)
+{
+    string result;
+
+    // If there's a prefix, it makes a fine identifier
+    if (!conn.prefix.empty()) return conn.prefix;
+
+    // Otherwise, build an upper-case identifier from the connection name
+    for (char c : conn.name)
+    {
+        if (c >= 'a' && c <= 'z') c &= ~32;
+        if (!isalnum(c)) c = '_';
+        if (c == '_' && (result.empty() || result.back() == '_')) continue;
+        result += c;
+    }
+
+    // Hand the caller the identifier
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// address_space_ident() - Returns an identifier that names an address space.
+//                          Characters that can't be in an identifier become
+//                          underscores, so "/cpu/Data" becomes "cpu_Data"
+//=============================================================================
+string address_space_ident(const string& space)
+{
+    string result;
+
+    for (char c : space)
+    {
+        if (!isalnum(c)) c = '_';
+        if (c == '_' && (result.empty() || result.back() == '_')) continue;
+        result += c;
+    }
+
+    // Don't leave a trailing underscore
+    if (!result.empty() && result.back() == '_') result.pop_back();
+
+    return result;
+}
+//=============================================================================
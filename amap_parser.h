@@ -2,15 +2,44 @@
 #include <cstdint>
 #include <string>
 #include <map>
+#include <memory>
+#include "vreg_parser.h"
+#include "vreg_diag.h"
 
 struct connection_t
 {
-    std::string name;
-    uint64_t    address;
-    std::string filename;
-    std::string prefix;
+    std::string         name;
+    uint64_t            address;
+
+    // The address space that "address" is in.  This is the path of the master
+    // in the address map key: "/cpu/Data" for "/cpu/Data/SEG_x.offset"
+    std::string         space;
+    std::string         filename;
+    std::string         prefix;
+    std::vector<vreg_t> regs;
+
+    // The line of the address map that gave the connection its address
+    uint32_t            line;
+
+    // The arena that holds the strings in "regs"
+    std::shared_ptr<const CStringArena> strings;
 };
 
-void parse_address_map(std::string filename, std::map<std::string, connection_t>* addrmap);
+// Parses an address map.  If "diag" is given, malformed lines are recorded
+// there and skipped, otherwise the first one throws.  A connection that is
+// seen by more than one master gets an entry for each address space, keyed
+// by connection_key()
+void parse_address_map(std::string filename, std::map<std::string, connection_t>* addrmap,
+                       CDiagnostics* diag = nullptr);
+
+// Returns the key of a connection in an address map
+std::string connection_key(const std::string& space, const std::string& name);
+
+// Returns the address spaces in an address map, in sorted order
+std::vector<std::string> address_spaces(const std::map<std::string, connection_t>& addrmap);
 
+// Returns the C identifier that names a connection
+std::string connection_ident(const connection_t& conn);
 
+// Returns an identifier that names an address space: "/cpu/Data" is "cpu_Data"
+std::string address_space_ident(const std::string& space);
@@ -2,10 +2,14 @@
 // config_file.cpp - Implements a parser for configuration/settings files
 //==========================================================================================================
 #include <fstream>
+#include <mutex>
+#include <algorithm>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 #include "config_file.h"
 #include "tokenizer.h"
+#include "vreg_stamp.h"
 
 using namespace std;
 
@@ -152,18 +156,77 @@ static string parse_to_delimeter(const char* in, char delimeter)
 
 
 //==========================================================================================================
-// Call this to read the config file.  Returns 'true' on success, 'false' if file not found
+// One item of a parsed config file: either a spec or an "include" of another config file
+//==========================================================================================================
+struct config_item_t
+{
+    string                           section;   // The [section] the item appeared in, "" if none
+    string                           key;       // The key name of a spec, "" for an include
+    shared_ptr<const vector<string>> values;    // The values of a spec
+    string                           include;   // The path of an included file
+    vector<pair<size_t, string>>     splices;   // "include" lines in a script: where they go, and the path
+};
+
+// A parsed config file, exactly as written.  Includes aren't expanded in a fragment, so a cached fragment
+// stays valid for as long as its own file doesn't change
+typedef vector<config_item_t> config_fragment_t;
+
+// Every config file this process has parsed, by absolute path.  A file that is included into a script is
+// cached as a script, under its path with "{}" in front.  Shared by every CConfigFile
+static mutex fragment_mutex;
+static map<string, pair<file_stamp_t, shared_ptr<const config_fragment_t>>> fragment_cache;
+//==========================================================================================================
+
+
+//==========================================================================================================
+// include_path() - Returns the path of a file named by an "include" line.  Relative paths are relative to
+//                  the directory of the file that includes them
+//==========================================================================================================
+static string include_path(const char* in, const string& includer)
+{
+    // Skip over the word "include" and any spaces after it
+    in += 7;
+    while (*in == ' ' || *in == '\t') ++in;
+
+    // The filename may be in quotes or angle brackets
+    string name = in;
+    while (!name.empty() && (name.back() == ' ' || name.back() == '\t')) name.pop_back();
+    if (name.size() >= 2 && (name[0] == '"' || name[0] == '<')) name = name.substr(1, name.size() - 2);
+
+    // Make a relative path relative to the including file
+    size_t slash = includer.find_last_of('/');
+    if (name[0] != '/' && slash != string::npos) name = includer.substr(0, slash + 1) + name;
+
+    return absolute_path(name);
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// is_include() - Returns true if a line is an "include <filename>" line
+//==========================================================================================================
+static bool is_include(const char* p)
+{
+    return strncmp(p, "include", 7) == 0 && (p[7] == ' ' || p[7] == '\t') && !strchr(p, '=');
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// parse_fragment() - Parses a config file into a list of specs and includes.  If "as_script" is true,
+//                    the file was included into a script, and every line of it is a script line.  The
+//                    fragment is then a single item that holds those lines
 //
-// On Exit: m_specs = a container that maps a key-string to a vector of strings.
-//                    That vector of strings is either individual tokens, or in the case of a script
-//                    spec is a vector of untokenized lines
+// Returns: The parsed fragment, or nullptr if the file can't be opened
 //==========================================================================================================
-bool CConfigFile::read(string filename, bool msg_on_fail)
+static shared_ptr<const config_fragment_t> parse_fragment(const string& filename, bool as_script)
 {
     char     line[1000], *p;
-    strvec_t values;
-    string   base_key_name, scoped_key_name;
-    
+    vector<string> values;
+    vector<pair<size_t, string>> splices;
+    string   base_key_name;
+    auto     result = make_shared<config_fragment_t>();
+
     // We are not currently parsing a script
     bool in_script = false;
 
@@ -173,12 +236,8 @@ bool CConfigFile::read(string filename, bool msg_on_fail)
     // Open the input file
     FILE* ifile = fopen(filename.c_str(), "r");
 
-    // If the input file couldn't be opened, complain about it
-    if (ifile == NULL)
-    {
-        if (msg_on_fail) printf("Failed to open file \"%s\"\n", filename.c_str());
-        return false; 
-    }       
+    // If the input file couldn't be opened, tell the caller
+    if (ifile == NULL) return nullptr;
 
     // Loop through every line of the input file...
     while (fgets(line, sizeof line, ifile))
@@ -194,6 +253,20 @@ bool CConfigFile::read(string filename, bool msg_on_fail)
         // If the line is blank or is a comment, ignore it
         if (*p == 0 || *p == '#' || (p[0] == '/' && p[1] == '/')) continue;
 
+        // In a script, an "include" line is replaced by the lines of the file it names
+        if ((as_script || in_script) && is_include(p))
+        {
+            splices.push_back({values.size(), include_path(p, filename)});
+            continue;
+        }
+
+        // A file included into a script is nothing but script lines
+        if (as_script)
+        {
+            values.push_back(p);
+            continue;
+        }
+
         // If the line begins with '[', this is a section-name
         if (*p == '[')
         {
@@ -205,6 +278,7 @@ bool CConfigFile::read(string filename, bool msg_on_fail)
         if (*p == '{')
         {
             values.clear();
+            splices.clear();
             in_script = true;
             continue;
         }
@@ -212,7 +286,7 @@ bool CConfigFile::read(string filename, bool msg_on_fail)
         // If this is the end of a script, save the list of lines into our specs
         if (*p == '}')
         {
-            if (in_script) m_specs[scoped_key_name] = values;
+            if (in_script) result->push_back({parsing_section, base_key_name, make_shared<const vector<string>>(values), "", splices});
             in_script = false;
             continue;            
         }
@@ -224,12 +298,16 @@ bool CConfigFile::read(string filename, bool msg_on_fail)
             continue;
         }
 
+        // Is this an "include <filename>" line?
+        if (is_include(p))
+        {
+            result->push_back({parsing_section, "", nullptr, include_path(p, filename)});
+            continue;
+        }
+
         // Fetch the base name of this key 
         base_key_name = parse_to_delimeter(p, '=');
 
-        // Create the fully scoped name of this key
-        scoped_key_name = parsing_section + "::" + base_key_name;
-
         // We start out without a list of values for this key
         values.clear();
 
@@ -239,14 +317,177 @@ bool CConfigFile::read(string filename, bool msg_on_fail)
         // If it exists, parse the rest of the line after an '=' into a vector of string tokens    
         if (p) values = tokenizer.parse(p+1);
 
-        // Add this configuration spec to our master list of config specs
-        m_specs[scoped_key_name] = values;
-       
+        // Add this configuration spec to our list of config specs
+        result->push_back({parsing_section, base_key_name, make_shared<const vector<string>>(values), ""});
     }
 
     // We're done with the input file
     fclose(ifile);
 
+    // A file included into a script is a single script
+    if (as_script) result->push_back({"", "", make_shared<const vector<string>>(values), "", splices});
+
+    // Hand the caller the parsed file
+    return result;
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// fetch_fragment() - Returns the parsed contents of a config file, parsing it only if this process hasn't
+//                    already parsed the current version of the file
+//
+// Returns: The parsed fragment, or nullptr if the file can't be opened
+//==========================================================================================================
+static shared_ptr<const config_fragment_t> fetch_fragment(const string& path, bool as_script = false)
+{
+    string       key = as_script ? "{}" + path : path;
+    file_stamp_t stamp;
+
+    // Find out which version of the file we would be parsing
+    if (!get_file_stamp(path, &stamp)) return nullptr;
+
+    // If we've already parsed this version, share it
+    {
+        lock_guard<mutex> lock(fragment_mutex);
+        auto it = fragment_cache.find(key);
+        if (it != fragment_cache.end() && it->second.first == stamp) return it->second.second;
+    }
+
+    // Otherwise, parse the file and remember it
+    auto fragment = parse_fragment(path, as_script);
+    if (fragment)
+    {
+        lock_guard<mutex> lock(fragment_mutex);
+        fragment_cache[key] = {stamp, fragment};
+    }
+
+    return fragment;
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// splice_script() - Appends the lines of a script to "lines", replacing each "include" line in it with the
+//                   lines of the file it names
+//
+// Passed: item    = The script
+//         stack   = The files that are being included, outermost first
+//         p_files = Every file read so far.  Files that get spliced in are added to it
+//==========================================================================================================
+static void splice_script(const config_item_t& item, vector<string>& stack, vector<string>* p_files,
+                          vector<string>* p_lines)
+{
+    size_t next = 0;
+
+    for (auto& splice : item.splices)
+    {
+        const string& path = splice.second;
+
+        // Copy the lines that come before the "include"
+        p_lines->insert(p_lines->end(), item.values->begin() + next, item.values->begin() + splice.first);
+        next = splice.first;
+
+        // If this file is already being included, the includes form a cycle
+        if (find(stack.begin(), stack.end(), path) != stack.end())
+        {
+            string cycle;
+            for (auto& f : stack) cycle += f + " -> ";
+            throw runtime_error("config include cycle: " + cycle + path);
+        }
+
+        // Fetch the file as a script
+        auto fragment = fetch_fragment(path, true);
+        if (!fragment) throw runtime_error("can't open included config file " + path + " (included from " + stack.back() + ")");
+        if (find(p_files->begin(), p_files->end(), path) == p_files->end()) p_files->push_back(path);
+
+        // And splice in its lines, along with any files that it includes
+        stack.push_back(path);
+        splice_script(fragment->front(), stack, p_files, p_lines);
+        stack.pop_back();
+    }
+
+    // Copy the lines after the last "include"
+    p_lines->insert(p_lines->end(), item.values->begin() + next, item.values->end());
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// merge() - Adds the specs of a config file, and of every file it includes, to our specs
+//
+// Passed: path    = Absolute path of the config file
+//         section = The section of the "include" line that included this file.  Specs that aren't in a
+//                   [section] of their own are added to this section
+//         stack   = The files that are being included, outermost first
+//==========================================================================================================
+void CConfigFile::merge(const string& path, const string& section, vector<string>& stack)
+{
+    // If this file is already being included, the includes form a cycle
+    if (find(stack.begin(), stack.end(), path) != stack.end())
+    {
+        string cycle;
+        for (auto& f : stack) cycle += f + " -> ";
+        throw runtime_error("config include cycle: " + cycle + path);
+    }
+
+    // Fetch the parsed file
+    auto fragment = fetch_fragment(path);
+    if (!fragment) throw runtime_error("can't open included config file " + path + " (included from " + stack.back() + ")");
+
+    // Keep track of every file we read, even if it's included more than once
+    if (find(m_files.begin(), m_files.end(), path) == m_files.end()) m_files.push_back(path);
+
+    // Add every spec in this file to ours, and merge in every file it includes
+    stack.push_back(path);
+    for (auto& item : *fragment)
+    {
+        const string& item_section = item.section.empty() ? section : item.section;
+        if (item.values && !item.splices.empty())
+        {
+            auto lines = make_shared<vector<string>>();
+            splice_script(item, stack, &m_files, lines.get());
+            m_specs[item_section + "::" + item.key] = lines;
+        }
+        else if (item.values)
+            m_specs[item_section + "::" + item.key] = item.values;
+        else
+            merge(item.include, item_section, stack);
+    }
+    stack.pop_back();
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// Call this to read the config file.  Returns 'true' on success, 'false' if file not found
+//
+// On Exit: m_specs = a container that maps a key-string to a vector of strings.
+//                    That vector of strings is either individual tokens, or in the case of a script
+//                    spec is a vector of untokenized lines
+//
+// A line of the form "include <filename>" adds the specs of another config file.  Inside a script's
+// "{ }", it is replaced by the lines of the named file instead.  A file that is included by many config
+// files is only parsed once per process, and its values are shared by all of them.  Throws runtime_error
+// if an included file can't be read or if includes form a cycle
+//==========================================================================================================
+bool CConfigFile::read(string filename, bool msg_on_fail)
+{
+    vector<string> stack;
+
+    // Included files are cached by absolute path
+    string path = absolute_path(filename);
+
+    // If the input file couldn't be opened, complain about it
+    if (!fetch_fragment(path))
+    {
+        if (msg_on_fail) printf("Failed to open file \"%s\"\n", filename.c_str());
+        return false; 
+    }       
+
+    // Add the specs of the file and everything it includes
+    merge(path, "", stack);
+
     // Tell the caller that all is well
     return true;
 }
@@ -270,13 +511,13 @@ void  CConfigFile::set_current_section(string section)
 //==========================================================================================================
 void CConfigFile::dump_specs()
 {
-    map<string, strvec_t>::iterator it;
+    config_spec_map_t::iterator it;
 
     // Loop through every entry in our map....
     for (it=m_specs.begin(); it != m_specs.end(); ++it)
     {
         // Get a convenient reference to string-vector in this entry
-        strvec_t& v = it->second;
+        const strvec_t& v = *it->second;
 
         // Display this item's key
         printf("Key \"%s\"\n", it->first.c_str());
@@ -324,7 +565,7 @@ bool CConfigFile::lookup(string key, strvec_t *p_result)
 bool CConfigFile::exists(string key, strvec_t *p_result)
 {
     // An iterator to our specs-map
-    map<string, strvec_t>::iterator it;
+    config_spec_map_t::iterator it;
 
     // Convert the key to lower-case
     make_lower(key);
@@ -342,7 +583,7 @@ bool CConfigFile::exists(string key, strvec_t *p_result)
         if (it != m_specs.end())
         {
             // If the caller wants the associated values, hand them to him
-            if (p_result) *p_result = it->second;
+            if (p_result) *p_result = *it->second;
         
             // Tell the caller that his key existed
             return true;
@@ -358,7 +599,7 @@ bool CConfigFile::exists(string key, strvec_t *p_result)
     // If that fully-scoped key exists, tell the caller
     if (it != m_specs.end())
     {
-        if (p_result) *p_result = it->second;
+        if (p_result) *p_result = *it->second;
         return true;
     }
 
@@ -368,7 +609,7 @@ bool CConfigFile::exists(string key, strvec_t *p_result)
     // If that globally-scoped key exists, tell the caller
     if (it != m_specs.end())
     {
-        if (p_result) *p_result = it->second;
+        if (p_result) *p_result = *it->second;
         return true;
     }
 
@@ -803,3 +1044,240 @@ double CConfigScript::get_next_float()
 //==========================================================================================================
 
 
+
+
+
+//==========================================================================================================
+// snapshot() - Returns a frozen copy of our specs
+//==========================================================================================================
+shared_ptr<const CConfigSnapshot> CConfigFile::snapshot() const
+{
+    return make_shared<const CConfigSnapshot>(m_specs, m_files);
+}
+//==========================================================================================================
+
+
+
+//==========================================================================================================
+// CConfigSnapshot() - Splits every fully-scoped key into its section name and key name
+//==========================================================================================================
+CConfigSnapshot::CConfigSnapshot(const config_spec_map_t& specs, const vector<string>& files) : m_files(files)
+{
+    for (auto& spec : specs)
+    {
+        size_t scope = spec.first.find("::");
+        m_section[spec.first.substr(0, scope)][spec.first.substr(scope + 2)] = spec.second;
+    }
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// load() - Parses a config file into a new snapshot
+//==========================================================================================================
+shared_ptr<const CConfigSnapshot> CConfigSnapshot::load(string filename)
+{
+    CConfigFile config;
+
+    if (!config.read(filename, false)) throw runtime_error("can't open " + filename);
+
+    return config.snapshot();
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// find() - Looks up a key in the specified section, falling back to the global section
+//
+// Returns: A pointer to the key's values, or NULL if the key doesn't exist
+//==========================================================================================================
+const CConfigSnapshot::strvec_t* CConfigSnapshot::find(string section, string key) const
+{
+    // Section and key names are stored in lower-case
+    make_lower(section);
+    make_lower(key);
+
+    // Look in the specified section first, then in the global section
+    for (auto& name : {section, string()})
+    {
+        auto s = m_section.find(name);
+        if (s == m_section.end()) continue;
+        auto k = s->second.find(key);
+        if (k != s->second.end()) return k->second.get();
+    }
+
+    // If we get here, the key doesn't exist
+    return NULL;
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// lookup() - Like "find()", but throws a runtime_error if the key doesn't exist
+//==========================================================================================================
+const CConfigSnapshot::strvec_t& CConfigSnapshot::lookup(const string& section, const string& key) const
+{
+    const strvec_t* values = find(section, key);
+    if (values == NULL) throw runtime_error("config key '"+key+"' not found");
+    return *values;
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// value() - Fetches a single value of a key, or an empty string if the key doesn't have that many values
+//==========================================================================================================
+const string& CConfigSnapshot::value(const string& section, const string& key, int index) const
+{
+    static const string empty;
+    const strvec_t& values = lookup(section, key);
+    return (index < values.size()) ? values[index] : empty;
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// get_xxx() - These fetch the value at position "index" of a key as a native type
+//==========================================================================================================
+int32_t  CConfigSnapshot::get_int   (string section, string key, int index) const {int32_t  v; decode(value(section, key, index), &v); return v;}
+uint32_t CConfigSnapshot::get_uint  (string section, string key, int index) const {uint32_t v; decode(value(section, key, index), &v); return v;}
+int64_t  CConfigSnapshot::get_int64 (string section, string key, int index) const {int64_t  v; decode(value(section, key, index), &v); return v;}
+uint64_t CConfigSnapshot::get_uint64(string section, string key, int index) const {uint64_t v; decode(value(section, key, index), &v); return v;}
+double   CConfigSnapshot::get_float (string section, string key, int index) const {double   v; decode(value(section, key, index), &v); return v;}
+string   CConfigSnapshot::get_string(string section, string key, int index) const {return value(section, key, index);}
+bool     CConfigSnapshot::get_bool  (string section, string key, int index) const {bool     v; decode(value(section, key, index), &v); return v;}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// get_script() - Fetches the script-spec that is associated with the specified key
+//==========================================================================================================
+void CConfigSnapshot::get_script(string section, string key, CConfigScript* p_script) const
+{
+    *p_script = lookup(section, key);
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// section() - Returns the keys and values of the specified section, or NULL if there's no such section.
+//             Section names are stored in lower-case, so the name is lower-cased into a buffer on the
+//             stack; only a name too long for the buffer gets copied to the heap
+//==========================================================================================================
+const map<string, shared_ptr<const CConfigSnapshot::strvec_t>>* CConfigSnapshot::section(const string& name) const
+{
+    char   buffer[128];
+    string long_name;
+    std::string_view lower;
+
+    if (name.size() < sizeof buffer)
+    {
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            char c = name[i];
+            buffer[i] = (c >= 'A' && c <= 'Z') ? (c | 32) : c;
+        }
+        lower = std::string_view(buffer, name.size());
+    }
+    else
+    {
+        long_name = name;
+        make_lower(long_name);
+        lower = long_name;
+    }
+
+    auto it = m_section.find(lower);
+    return (it == m_section.end()) ? NULL : &it->second;
+}
+//==========================================================================================================
+
+
+
+//==========================================================================================================
+// strip_underscores() - Copies a numeric string into a buffer without its '_' separators.  Returns false
+//                       if the string is empty or too long
+//==========================================================================================================
+static bool strip_underscores(const string& s, char* buffer, size_t size)
+{
+    char* out = buffer;
+
+    for (char c : s)
+    {
+        if (c == '_') continue;
+        if (out == buffer + size - 1) return false;
+        *out++ = c;
+    }
+
+    *out = 0;
+    return out != buffer;
+}
+//==========================================================================================================
+
+
+//==========================================================================================================
+// config_decode() - Strictly converts a config value to a native type
+//
+// Returns: true if the entire string was a valid value that fits in the result type
+//==========================================================================================================
+bool config_decode(const string& s, int64_t* p_result)
+{
+    char buffer[100], *end;
+    if (!strip_underscores(s, buffer, sizeof buffer)) return false;
+    errno = 0;
+    *p_result = strtoll(buffer, &end, 0);
+    return *end == 0 && errno == 0;
+}
+
+bool config_decode(const string& s, uint64_t* p_result)
+{
+    char buffer[100], *end;
+    if (!strip_underscores(s, buffer, sizeof buffer) || buffer[0] == '-') return false;
+    errno = 0;
+    *p_result = strtoull(buffer, &end, 0);
+    return *end == 0 && errno == 0;
+}
+
+bool config_decode(const string& s, int32_t* p_result)
+{
+    int64_t value;
+    if (!config_decode(s, &value) || value < INT32_MIN || value > INT32_MAX) return false;
+    *p_result = (int32_t)value;
+    return true;
+}
+
+bool config_decode(const string& s, uint32_t* p_result)
+{
+    uint64_t value;
+    if (!config_decode(s, &value) || value > UINT32_MAX) return false;
+    *p_result = (uint32_t)value;
+    return true;
+}
+
+bool config_decode(const string& s, double* p_result)
+{
+    char* end;
+    if (s.empty()) return false;
+    *p_result = strtod(s.c_str(), &end);
+    return *end == 0;
+}
+
+bool config_decode(const string& s, bool* p_result)
+{
+    string word = s;
+    make_lower(word);
+
+    if (word == "true" || word == "on"  || word == "yes") {*p_result = true;  return true;}
+    if (word == "false"|| word == "off" || word == "no" ) {*p_result = false; return true;}
+
+    int64_t value;
+    if (!config_decode(s, &value)) return false;
+    *p_result = (value != 0);
+    return true;
+}
+
+bool config_decode(const string& s, string* p_result)
+{
+    *p_result = s;
+    return true;
+}
+//==========================================================================================================
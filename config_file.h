@@ -4,9 +4,15 @@
 #pragma once
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <map>
+#include <memory>
+
+// Maps a fully-scoped ("section::key") spec name to its values.  Parsed values are never modified, so
+// they are shared by every config that contains them
+typedef std::map<std::string, std::shared_ptr<const std::vector<std::string>>> config_spec_map_t;
 
 //----------------------------------------------------------------------------------------------------------
 // CConfigScript() - Provides a convenient interface for parsing script-specs in a config-file
@@ -28,6 +34,9 @@ public:
     // Call this to erase the script
     void        make_empty();
 
+    // Returns the number of lines in the script
+    int         line_count() const {return m_script.size();}
+
     // Overloading the '=' operator so we can assign a string vector
     void        operator=(const std::vector<std::string> rhs) {m_script = rhs; rewind();}
 
@@ -46,6 +55,293 @@ protected:
 
 
 
+//----------------------------------------------------------------------------------------------------------
+// CConfigSnapshot - A frozen, read-only set of config specs.  A snapshot never changes after it's built
+//                   and has no "current section" state (the section is passed to every call), so any
+//                   number of threads can query the same snapshot at once without locking
+//----------------------------------------------------------------------------------------------------------
+class CConfigSnapshot
+{
+public:
+
+    typedef std::vector<std::string> strvec_t;
+
+    // Builds a snapshot from a map of fully-scoped ("section::key") specs, read from "files"
+    explicit CConfigSnapshot(const config_spec_map_t& specs, const std::vector<std::string>& files = {});
+
+    // Parses a config file into a snapshot.  Throws runtime_error if the file can't be read
+    static std::shared_ptr<const CConfigSnapshot> load(std::string filename);
+
+    // Returns the values of a key in a section (or the global section), or NULL if the key doesn't exist
+    const strvec_t* find(std::string section, std::string key) const;
+
+    // Tells the caller whether or not a key exists in a section (or the global section)
+    bool        exists(std::string section, std::string key) const {return find(section, key) != NULL;}
+
+    // Fetch the value at position "index" of a key.  These throw runtime_error if the key doesn't exist
+    int32_t     get_int   (std::string section, std::string key, int index = 0) const;
+    uint32_t    get_uint  (std::string section, std::string key, int index = 0) const;
+    int64_t     get_int64 (std::string section, std::string key, int index = 0) const;
+    uint64_t    get_uint64(std::string section, std::string key, int index = 0) const;
+    double      get_float (std::string section, std::string key, int index = 0) const;
+    std::string get_string(std::string section, std::string key, int index = 0) const;
+    bool        get_bool  (std::string section, std::string key, int index = 0) const;
+
+    // Fetch a script-spec.  Throws runtime_error if the key doesn't exist
+    void        get_script(std::string section, std::string key, CConfigScript* p_script) const;
+
+    // Returns the keys and values of a section, or NULL if there is no such section
+    const std::map<std::string, std::shared_ptr<const strvec_t>>* section(const std::string& name) const;
+
+    // Returns the absolute paths of the config file and every file it includes
+    const std::vector<std::string>& files() const {return m_files;}
+
+protected:
+
+    // Like "find()", but throws runtime_error if the key doesn't exist
+    const strvec_t& lookup(const std::string& section, const std::string& key) const;
+
+    // Fetches the value at position "index" of a key, or "" if the key has fewer values
+    const std::string& value(const std::string& section, const std::string& key, int index) const;
+
+    // Section name -> key name -> values.  The global section is "".  Sections can be looked up by
+    // std::string_view, so that section() can look one up without building a std::string
+    std::map<std::string, std::map<std::string, std::shared_ptr<const strvec_t>>, std::less<>> m_section;
+
+    // The files the specs were read from
+    std::vector<std::string> m_files;
+};
+//----------------------------------------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------------------------------------
+// Strict conversions of a single config value.  These return false if the string isn't a valid value of
+// that type (or is out of range), rather than quietly producing zero
+//----------------------------------------------------------------------------------------------------------
+bool config_decode(const std::string& s, int32_t     *p_result);
+bool config_decode(const std::string& s, uint32_t    *p_result);
+bool config_decode(const std::string& s, int64_t     *p_result);
+bool config_decode(const std::string& s, uint64_t    *p_result);
+bool config_decode(const std::string& s, double      *p_result);
+bool config_decode(const std::string& s, bool        *p_result);
+bool config_decode(const std::string& s, std::string *p_result);
+//----------------------------------------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------------------------------------
+// CConfigSchema - Binds config keys to the members of a struct, once, with a declared type, default and
+//                 number of values for each key.  populate() then fills in an entire struct in a single
+//                 pass over the specs of a snapshot, and reports every missing or invalid key at once.
+//
+// Example:
+//      struct settings_t {uint32_t speed; std::string name; std::vector<int32_t> lanes;};
+//
+//      static const auto schema = CConfigSchema<settings_t>()
+//          .bind("speed", &settings_t::speed, 100u)            // Optional, with a default
+//          .bind("name",  &settings_t::name)                   // Required
+//          .bind("lanes", &settings_t::lanes, 1, 4);           // Required, 1 to 4 values
+//
+//      schema.populate(*snapshot, "hw", &settings);
+//----------------------------------------------------------------------------------------------------------
+template <typename S> class CConfigSchema
+{
+public:
+
+    typedef std::vector<std::string> strvec_t;
+
+    // Binds a required key that has exactly one value
+    template <typename T> CConfigSchema& bind(std::string key, T S::* member)
+    {
+        return add(key, new scalar_binding<T>(member, T(), false));
+    }
+
+    // Binds an optional key that has exactly one value
+    template <typename T, typename D> CConfigSchema& bind(std::string key, T S::* member, D default_value)
+    {
+        return add(key, new scalar_binding<T>(member, T(default_value), true));
+    }
+
+    // Binds a required key that has between "min_count" and "max_count" values
+    template <typename T> CConfigSchema& bind(std::string key, std::vector<T> S::* member,
+                                              size_t min_count, size_t max_count)
+    {
+        return add(key, new vector_binding<T>(member, min_count, max_count));
+    }
+
+    // Binds a script-spec.  If "required" is false, a missing script is an empty script
+    CConfigSchema& bind(std::string key, CConfigScript S::* member, bool required)
+    {
+        return add(key, new script_binding(member, required));
+    }
+
+    // Fills in "p_struct" from a section of a snapshot (keys in the section override global keys).
+    // Returns false and fills in "p_errors" with every problem if any key is missing or invalid
+    bool populate(const CConfigSnapshot& config, const std::string& section, S* p_struct,
+                  std::vector<std::string>* p_errors) const
+    {
+        auto global = config.section(std::string());
+        auto local  = section.empty() ? NULL : config.section(section);
+
+        // Store each value, or its default
+        p_errors->clear();
+        for (size_t i = 0; i < m_binding.size(); ++i)
+        {
+            const binding&  b     = *m_binding[i];
+            const strvec_t* found = NULL;
+            for (auto specs : {local, global})
+            {
+                if (specs == NULL) continue;
+                auto it = specs->find(m_key[i]);
+                if (it != specs->end()) {found = it->second.get(); break;}
+            }
+            std::string error = found ? b.assign(*found, p_struct) : b.assign_default(p_struct);
+            if (!error.empty()) p_errors->push_back("config key '" + m_key[i] + "' " + error);
+        }
+
+        return p_errors->empty();
+    }
+
+    // Like the above, but throws a runtime_error that lists every problem
+    void populate(const CConfigSnapshot& config, const std::string& section, S* p_struct) const
+    {
+        std::vector<std::string> errors;
+        if (populate(config, section, p_struct, &errors)) return;
+        std::string message = errors[0];
+        for (size_t i = 1; i < errors.size(); ++i) message += "\n" + errors[i];
+        throw std::runtime_error(message);
+    }
+
+protected:
+
+    // A binding stores the values of one key into one member of the struct
+    struct binding
+    {
+        virtual ~binding() {}
+
+        // These return an error message, or "" on success
+        virtual std::string assign(const strvec_t& values, S* p_struct) const = 0;
+        virtual std::string assign_default(S* p_struct) const = 0;
+    };
+
+    template <typename T> struct scalar_binding : public binding
+    {
+        scalar_binding(T S::* m, T d, bool o) : member(m), default_value(d), optional(o) {}
+
+        std::string assign(const strvec_t& values, S* p_struct) const override
+        {
+            if (values.size() != 1) return "needs 1 value, has " + std::to_string(values.size());
+            if (!config_decode(values[0], &(p_struct->*member))) return "has invalid value '" + values[0] + "'";
+            return "";
+        }
+
+        std::string assign_default(S* p_struct) const override
+        {
+            if (!optional) return "not found";
+            p_struct->*member = default_value;
+            return "";
+        }
+
+        T S::*  member;
+        T       default_value;
+        bool    optional;
+    };
+
+    template <typename T> struct vector_binding : public binding
+    {
+        vector_binding(std::vector<T> S::* m, size_t lo, size_t hi) : member(m), min_count(lo), max_count(hi) {}
+
+        std::string assign(const strvec_t& values, S* p_struct) const override
+        {
+            std::vector<T>& out = p_struct->*member;
+            if (values.size() < min_count || values.size() > max_count)
+            {
+                return "needs " + std::to_string(min_count) + " to " + std::to_string(max_count)
+                     + " values, has " + std::to_string(values.size());
+            }
+            out.resize(values.size());
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                T value;
+                if (!config_decode(values[i], &value)) return "has invalid value '" + values[i] + "'";
+                out[i] = value;
+            }
+            return "";
+        }
+
+        std::string assign_default(S* p_struct) const override
+        {
+            if (min_count) return "not found";
+            (p_struct->*member).clear();
+            return "";
+        }
+
+        std::vector<T> S::* member;
+        size_t              min_count, max_count;
+    };
+
+    struct script_binding : public binding
+    {
+        script_binding(CConfigScript S::* m, bool r) : member(m), required(r) {}
+
+        std::string assign(const strvec_t& values, S* p_struct) const override
+        {
+            p_struct->*member = values;
+            return "";
+        }
+
+        std::string assign_default(S* p_struct) const override
+        {
+            if (required) return "not found";
+            (p_struct->*member).make_empty();
+            return "";
+        }
+
+        CConfigScript S::* member;
+        bool               required;
+    };
+
+    // Adds a binding.  Keys are stored in lower-case, the way the specs are
+    CConfigSchema& add(std::string key, binding* p_binding)
+    {
+        for (char& c : key) if (c >= 'A' && c <= 'Z') c |= 32;
+        m_key.push_back(key);
+        m_binding.emplace_back(p_binding);
+        return *this;
+    }
+
+    // The key of each binding, in the order they were bound
+    std::vector<std::string>                m_key;
+    std::vector<std::shared_ptr<binding>>   m_binding;
+};
+//----------------------------------------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------------------------------------
+// CConfigSource - Hands out the current snapshot of a config file, and publishes a new snapshot when the
+//                 file is reloaded.  Readers keep whatever snapshot they fetched for as long as they hold
+//                 it; a reload never changes a snapshot that someone is reading
+//----------------------------------------------------------------------------------------------------------
+class CConfigSource
+{
+public:
+
+    // Fetches the most recently published snapshot.  Safe to call from any thread
+    std::shared_ptr<const CConfigSnapshot> current() const {return std::atomic_load(&m_snapshot);}
+
+    // Atomically replaces the current snapshot.  Safe to call from any thread
+    void publish(std::shared_ptr<const CConfigSnapshot> snapshot) {std::atomic_store(&m_snapshot, snapshot);}
+
+    // Parses a config file and publishes it.  On failure, the current snapshot stays published
+    void reload(std::string filename) {publish(CConfigSnapshot::load(filename));}
+
+protected:
+
+    std::shared_ptr<const CConfigSnapshot> m_snapshot;
+};
+//----------------------------------------------------------------------------------------------------------
+
+
+
 //----------------------------------------------------------------------------------------------------------
 // CConfigFile - Provides a convenient interface for reading configuration files
 //----------------------------------------------------------------------------------------------------------
@@ -147,6 +443,13 @@ public:
     // Dumps out the m_specs in a human-readable form.  This is strictly for testing
     void    dump_specs();
 
+    // Returns a frozen copy of the specs that can be shared between threads
+    std::shared_ptr<const CConfigSnapshot> snapshot() const;
+
+    // Returns the absolute paths of every config file read so far, includes and all, in the order they
+    // were first read
+    const std::vector<std::string>& files() const {return m_files;}
+
 protected:
 
     // If this is true, fetching the value of an unknown spec will throw 
@@ -161,11 +464,17 @@ protected:
     // Call this to fetch the values-vector associated with a key.  Won't throw excption
     bool    exists(std::string, strvec_t *p_result);
 
+    // Adds the specs of a config file, and of every file it includes, to m_specs
+    void    merge(const std::string& path, const std::string& section, std::vector<std::string>& stack);
+
     // The section name to look for specs in
     std::string m_current_section;
 
     // Our configuration specs are a map of string vectors
-    std::map<std::string, strvec_t> m_specs;
+    config_spec_map_t m_specs;
+
+    // The config files that m_specs were read from
+    std::vector<std::string> m_files;
 };
 //----------------------------------------------------------------------------------------------------------
 
@@ -15,13 +15,36 @@ Date        Rev  Who  Description
 
 
 #include <string>
+#include <cstring>
 #include <cstdarg>
 #include <stdexcept>
+#include <set>
+#include <algorithm>
+#include <ctime>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "config_file.h"
 #include "vreg_parser.h"
 #include "amap_parser.h"
+#include "vreg_struct.h"
+#include "vreg_reset.h"
+#include "vreg_shadow.h"
+#include "vreg_snapshot.h"
+#include "vreg_burst.h"
+#include "vreg_names.h"
+#include "vreg_lib.h"
+#include "vreg_trace.h"
+#include "vreg_init.h"
+#include "vreg_hash.h"
+#include "vreg_serve.h"
+#include "vreg_prefetch.h"
+#include "vreg_pipeline.h"
+#include "vreg_diag.h"
+#include "vreg_enum.h"
 using std::string;
 using std::map;
+using std::vector;
 
 struct src_entry_t
 {
@@ -36,14 +59,79 @@ map<string, connection_t> connection;
 // Maps a connection name to a source file and prefix
 map<string, src_entry_t> src_map;
 
+// The absolute paths of the config file and every file it includes
+vector<string> config_files;
+
+// The address space being generated.  When the address map has more than one,
+// each gets output files of its own
+string current_space;
+bool   multiple_spaces;
+
+// The optional "init" script of symbolic register writes
+CConfigScript init_script;
+bool          has_init_script;
+
 string input_file;
 string output_file;
 string config_file = "xlate_vreg.conf";
+string lib_file;
+string hash_verilog_file;
+string dep_file;
+string only_space;
 
 bool   show_names;
+bool   relative;
+bool   make_struct;
+bool   with_masks;
+bool   reset_image;
+bool   make_shadow;
+bool   make_snapshot;
+bool   make_dump_plan;
+bool   make_name_table;
+bool   make_model;
+bool   make_trace;
+bool   make_map_hash;
+bool   show_stats;
+bool   make_depfile;
+
+// Gaps of up to this many bytes are read across in a burst read plan
+uint32_t dump_gap;
+
+// Output that would go to stdout goes here.  In server mode, that's a buffer
+FILE* stdout_file = stdout;
+
+// Anything else that would go to stderr (such as -stats) goes here.  In server mode, that's a buffer too
+FILE* stderr_file = stderr;
+
+// Parsed inputs, kept for as long as the files they came from don't change
+struct parsed_regs_t
+{
+    vector<vreg_t>                      regs;
+    std::shared_ptr<const CStringArena> strings;
+};
+CFileCache<map<string, connection_t>> address_map_cache;
+CFileCache<parsed_regs_t>             register_cache;
+
+// Reads the register source files in the background
+CFilePrefetcher prefetcher;
+
+// Where the time went in the read/parse/render pipeline
+pipeline_stats_t pipeline_stats;
+
+// Problems found in the inputs.  Parsing carries on past them, so that a
+// single run reports every one
+CDiagnostics diagnostics;
+
+// Thrown when the command line is invalid.  The message is the usage text
+struct usage_error : public std::runtime_error
+{
+    usage_error(const string& text) : std::runtime_error(text) {}
+};
 
 void execute();
+void generate();
 void parse_command_line(const char** argv);
+int  handle_request(const vector<string>& args, string* p_output, string* p_messages, string* p_error);
 
 
 //=============================================================================
@@ -51,12 +139,24 @@ void parse_command_line(const char** argv);
 //=============================================================================
 int main(int argc, const char** argv)
 {
-    parse_command_line(argv);
-
     try
     {
+        // Are we running as a generation daemon?
+        if (argv[1] && strcmp(argv[1], "-serve") == 0 && argv[2])
+            return serve(argv[2], handle_request);
+
+        // Are we handing our command line to a generation daemon?
+        if (argv[1] && strcmp(argv[1], "-client") == 0 && argv[2])
+            return serve_client(argv[2], argv + 3);
+
+        parse_command_line(argv);
         execute();
     }
+    catch(const usage_error& e)
+    {
+        printf("%s", e.what());
+        exit(1);
+    }
     catch(const std::exception& e)
     {
         fprintf(stderr, "xlate_vreg: %s\n", e.what());
@@ -85,6 +185,33 @@ static void throwRuntime(const char* fmt, ...)
 //=============================================================================
 
 
+//=============================================================================
+// strip_extension() - Returns a filename without its extension, if it has one
+//=============================================================================
+string strip_extension(const string& filename)
+{
+    size_t slash = filename.find_last_of('/');
+    size_t dot   = filename.find_last_of('.');
+    size_t start = (slash == string::npos) ? 0 : slash + 1;
+    return (dot == string::npos || dot < start) ? filename : filename.substr(0, dot);
+}
+//=============================================================================
+
+
+//=============================================================================
+// space_file() - Returns the name of an output file for the address space
+//                being generated.  If there's more than one address space,
+//                "regs.h" for "/cpu/Data" becomes "regs_cpu_Data.h"
+//=============================================================================
+string space_file(const string& filename)
+{
+    if (!multiple_spaces || filename.empty()) return filename;
+    string stem = strip_extension(filename);
+    return stem + "_" + address_space_ident(current_space) + filename.substr(stem.size());
+}
+//=============================================================================
+
+
 
 //=============================================================================
 // reorder_connections() - Returns a copy of the "connection" map, reordered
@@ -106,14 +233,27 @@ map<uint64_t, connection_t> reorder_connections()
 
 //=============================================================================
 // show_connection_names() - Displays a list of connection names and their 
-//                           AXI addresses
+//                           AXI addresses.  With more than one address space,
+//                           each space gets a list of its own
 //=============================================================================
-void show_connection_names()
+void show_connection_names(const vector<string>& spaces)
 {
-    auto reordered = reorder_connections();
-    for (auto& e : reordered)
+    for (size_t i = 0; i < spaces.size(); ++i)
     {
-        printf("0x%016lx  %s\n", e.second.address, e.second.name.c_str());
+        map<uint64_t, const connection_t*> by_address;
+
+        // As in reorder_connections(), the last connection at an address wins
+        for (auto& c : connection)
+        {
+            if (c.second.space == spaces[i]) by_address[c.second.address] = &c.second;
+        }
+
+        if (multiple_spaces) fprintf(stdout_file, "%s%s:\n", i ? "\n" : "", spaces[i].c_str());
+
+        for (auto& e : by_address)
+        {
+            fprintf(stdout_file, "0x%016lx  %s\n", e.first, e.second->name.c_str());
+        }
     }
 }
 //=============================================================================
@@ -124,9 +264,13 @@ void show_connection_names()
 //=============================================================================
 void show_help()
 {
-    printf("xlate_vreg %s\n", REVISION);
-    printf("usage: xlate_vreg [-names] [-config <config_file>] <input_file> [output_file]\n");
-    exit(1);
+    throw usage_error
+    (
+        "xlate_vreg " REVISION "\n"
+        "usage: xlate_vreg [-names] [-relative] [-struct] [-masks] [-reset_image] [-shadow] [-snapshot] [-dump_plan] [-dump_gap <bytes>] [-name_table] [-hash] [-hash_v <verilog_file>] [-lib <lib_file> [-model] [-trace]] [-stats] [-MD] [-MF <dep_file>] [-space <master_path>] [-config <config_file>] <input_file> [output_file]\n"
+        "       xlate_vreg -serve <socket>\n"
+        "       xlate_vreg -client <socket> <arguments>\n"
+    );
 }
 //=============================================================================
 
@@ -152,6 +296,133 @@ void parse_command_line(const char** argv)
             continue;
         }
 
+        // Does the user want constants emitted relative to per-connection base macros?
+        if (token == "-relative")
+        {
+            relative = true;
+            continue;
+        }
+
+        // Does the user want a struct overlay for each connection?
+        if (token == "-struct")
+        {
+            make_struct = true;
+            continue;
+        }
+
+        // Does the user want reset values and write-masks for each register?
+        if (token == "-masks")
+        {
+            with_masks = true;
+            continue;
+        }
+
+        // Does the user want a reset image for each connection?
+        if (token == "-reset_image")
+        {
+            reset_image = true;
+            continue;
+        }
+
+        // Does the user want shadow registers for each connection?
+        if (token == "-shadow")
+        {
+            make_shadow = true;
+            continue;
+        }
+
+        // Does the user want a snapshot decoder for each connection?
+        if (token == "-snapshot")
+        {
+            make_snapshot = true;
+            continue;
+        }
+
+        // Does the user want a burst read plan for each connection?
+        if (token == "-dump_plan")
+        {
+            make_dump_plan = true;
+            continue;
+        }
+
+        // Is the user supplying the largest gap a burst can be padded across?
+        if (token == "-dump_gap" && argv[idx+1])
+        {
+            dump_gap = strtoul(argv[++idx], nullptr, 0);
+            continue;
+        }
+
+        // Does the user want a perfect-hash table of register and field names?
+        if (token == "-name_table")
+        {
+            make_name_table = true;
+            continue;
+        }
+
+        // Does the user want a hash of the register map?
+        if (token == "-hash")
+        {
+            make_map_hash = true;
+            continue;
+        }
+
+        // Is the user supplying the name of a Verilog file for the register map hash?
+        if (token == "-hash_v" && argv[idx+1])
+        {
+            hash_verilog_file = argv[++idx];
+            continue;
+        }
+
+        // Is the user supplying the name of a C++ access library to create?
+        if (token == "-lib" && argv[idx+1])
+        {
+            lib_file = argv[++idx];
+            continue;
+        }
+
+        // Does the user want a device model in the C++ access library?
+        if (token == "-model")
+        {
+            make_model = true;
+            continue;
+        }
+
+        // Does the user want access tracing in the C++ access library?
+        if (token == "-trace")
+        {
+            make_trace = true;
+            continue;
+        }
+
+        // Does the user want to see memory and timing statistics?
+        if (token == "-stats")
+        {
+            show_stats = true;
+            continue;
+        }
+
+        // Does the user want a Make/Ninja dependency file?
+        if (token == "-MD")
+        {
+            make_depfile = true;
+            continue;
+        }
+
+        // Is the user supplying the name of the dependency file?
+        if (token == "-MF" && argv[idx+1])
+        {
+            make_depfile = true;
+            dep_file     = argv[++idx];
+            continue;
+        }
+
+        // Does the user want only one of the address spaces?
+        if (token == "-space" && argv[idx+1])
+        {
+            only_space = argv[++idx];
+            continue;
+        }
+
         // Is the user supplying the name of a config file?
         if (token == "-config" && argv[idx+1])
         {
@@ -173,48 +444,95 @@ void parse_command_line(const char** argv)
 
     // If we don't have the name of an input file, complain
     if (input_file.empty()) show_help();
+
+    // The device model is part of the C++ access library
+    if (make_model && lib_file.empty()) show_help();
+
+    // So is access tracing
+    if (make_trace && lib_file.empty()) show_help();
+
+    // A dependency file needs an output file to be the target of its rule
+    if (make_depfile && output_file.empty()) show_help();
+
+    // Like a compiler's "-MD", the dependency file goes next to the output by default
+    if (make_depfile && dep_file.empty()) dep_file = strip_extension(output_file) + ".d";
 }
 //=============================================================================
 
 
 //=============================================================================
-// read_config_file() - Read the contents of the configuration file
+// read_config_file() - Read the contents of the configuration file.  Config
+//                      files (and the files they include) are only parsed
+//                      once per process, for as long as they don't change
 //=============================================================================
 void read_config_file(string filename)
 {
-    src_entry_t   entry;
-    CConfigFile   config;
-    CConfigScript script;
+    src_entry_t entry;
 
-    // If errors occur, throw exceptions
-    config.throw_on_fail(true);
-
-    // Open the configuration file
-    if (!config.read(filename, false))
+    // These are the specs we use from the configuration file
+    struct spec_t
     {
-        throwRuntime("can't open %s", filename.c_str());
-    }
+        CConfigScript connections;
+        CConfigScript init;
+    } spec;
+
+    static const auto schema = CConfigSchema<spec_t>()
+        .bind("connections", &spec_t::connections, true)
+        .bind("init",        &spec_t::init,        false);
 
-    // Fetch the "connections" script
-    config.get("connections", &script);
+    // Parse the configuration file and fetch our specs.  This throws if the
+    // file can't be read or a required spec is missing
+    auto snapshot = CConfigSnapshot::load(filename);
+    schema.populate(*snapshot, "", &spec);
+    config_files = snapshot->files();
 
-    // Loop through each line of that script, and add an entry
+    // Loop through each line of the "connections" script, and add an entry
     // to the "src_map"
-    while (script.get_next_line())
+    while (spec.connections.get_next_line())
     {
-        entry.name     = script.get_next_token();
-        entry.filename = script.get_next_token();
-        entry.prefix   = script.get_next_token();
+        entry.name     = spec.connections.get_next_token();
+        entry.filename = spec.connections.get_next_token();
+        entry.prefix   = spec.connections.get_next_token();
         src_map[entry.name] = entry;
     }
 
+    // Keep the "init" script, if there is one
+    init_script     = spec.init;
+    has_init_script = spec.init.line_count() > 0;
+}
+//=============================================================================
+
+
+//=============================================================================
+// read_address_map() - Reads the address map, unless we already have the
+//                      current version of it
+//=============================================================================
+void read_address_map(string filename)
+{
+    file_stamp_t stamp;
+    string       key = absolute_path(filename);
+
+    // If we have already parsed this version of the file, use it
+    auto cached = address_map_cache.find(key, filename);
+    if (cached)
+    {
+        connection = *cached;
+        return;
+    }
+
+    // Otherwise, parse it and remember what it held, unless it was malformed
+    bool   stamped = get_file_stamp(filename, &stamp);
+    size_t errors  = diagnostics.count();
+    parse_address_map(filename, &connection, &diagnostics);
+    if (stamped && diagnostics.count() == errors) address_map_cache.store(key, stamp, connection);
 }
 //=============================================================================
 
 
 //=============================================================================
 // merge_maps() - Fill in missing fields in "connection" from the matching 
-//                connection names in "src_map"
+//                connection names in "src_map".  Every connection that isn't
+//                in "src_map" is reported, and is left without a source file
 //=============================================================================
 void merge_maps()
 {
@@ -230,11 +548,11 @@ void merge_maps()
         // If this connection isn't in the src_map, complain
         if (it == src_map.end())
         {
-            throwRuntime
-            (   "'%s' not defined in %s",
-                connection_name.c_str(),
-                config_file.c_str()
+            diagnostics.error
+            (   input_file, c.second.line, 0,
+                "'" + connection_name + "' not defined in " + config_file
             );
+            continue;
         }
 
         // Fill in the fields in "connection" with their corresponding
@@ -247,28 +565,134 @@ void merge_maps()
 
 
 //=============================================================================
-// create_output_file() - Creates the output file, if any
+// create_temp_output() - Creates a temporary file next to "filename" to write
+//                        the output to.  It replaces "filename" only once it
+//                        is complete, so an error part of the way through
+//                        never leaves a half-written file behind.  If there's
+//                        no filename, we write straight to stdout
 //=============================================================================
-FILE* create_output_file(string filename)
+FILE* create_temp_output(const string& filename, string* p_temp)
 {
-    // Get a pointer to the filename
-    const char* fn = filename.c_str();
+    p_temp->clear();
 
     // If there's no filename, we're going to write to stdout
-    if (*fn == 0) return stdout;
+    if (filename.empty()) return stdout_file;
 
-    // Create the output file
-    FILE* ofile = fopen(fn, "w");
+    // Create the temporary file and complain if we can't
+    string temp = filename + ".XXXXXX";
+    int fd = mkstemp(&temp[0]);
+    if (fd < 0) throwRuntime("can't create %s", filename.c_str());
 
-    // If we can't create the output file, complain
-    if (ofile == nullptr) throwRuntime("can't create %s", fn);
+    // mkstemp() makes the file private.  Give it the permissions fopen() would
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
 
-    // Hand the caller a stream
-    return ofile;
+    *p_temp = temp;
+    return fdopen(fd, "w");
 }
 //=============================================================================
 
 
+//=============================================================================
+// same_contents() - Returns true if two files exist and hold the same bytes
+//=============================================================================
+bool same_contents(const string& filename1, const string& filename2)
+{
+    struct stat st1, st2;
+    char        buffer1[65536], buffer2[65536];
+    bool        same = true;
+
+    // Files of different sizes can't be the same
+    if (stat(filename1.c_str(), &st1) || stat(filename2.c_str(), &st2)) return false;
+    if (st1.st_size != st2.st_size) return false;
+
+    FILE* file1 = fopen(filename1.c_str(), "r");
+    FILE* file2 = fopen(filename2.c_str(), "r");
+
+    // Compare the files a block at a time
+    while (file1 && file2 && same)
+    {
+        size_t n1 = fread(buffer1, 1, sizeof buffer1, file1);
+        size_t n2 = fread(buffer2, 1, sizeof buffer2, file2);
+        same = (n1 == n2) && memcmp(buffer1, buffer2, n1) == 0;
+        if (n1 < sizeof buffer1) break;
+    }
+
+    if (file1 == nullptr || file2 == nullptr) same = false;
+    if (file1) fclose(file1);
+    if (file2) fclose(file2);
+    return same;
+}
+//=============================================================================
+
+
+//=============================================================================
+// commit_temp_output() - Closes a temporary output file and moves it into
+//                        place as "filename".
+//
+// If "filename" already holds exactly what we wrote, it's left alone, so its
+// timestamp only changes when its contents do.  That lets Make and Ninja
+// ("restat = 1") skip everything that depends on an output that didn't change
+//=============================================================================
+void commit_temp_output(FILE* ofile, const string& temp, const string& filename)
+{
+    // If we were writing to stdout, there's nothing to move
+    if (temp.empty()) return;
+
+    bool ok = !ferror(ofile);
+    if (fclose(ofile) != 0) ok = false;
+
+    // If the file hasn't changed, don't touch it
+    if (ok && same_contents(temp, filename))
+    {
+        unlink(temp.c_str());
+        return;
+    }
+
+    if (ok && rename(temp.c_str(), filename.c_str()) == 0) return;
+
+    unlink(temp.c_str());
+    throwRuntime("can't write %s", filename.c_str());
+}
+//=============================================================================
+
+
+//=============================================================================
+// discard_temp_output() - Closes and deletes a temporary output file
+//=============================================================================
+void discard_temp_output(FILE* ofile, const string& temp)
+{
+    if (temp.empty()) return;
+    fclose(ofile);
+    unlink(temp.c_str());
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_output() - Creates an output file, has "writer" fill it in, and moves
+//                  it into place.  If there's no filename, it goes to stdout
+//=============================================================================
+void write_output(const string& filename, std::function<void(FILE*)> writer)
+{
+    string temp;
+    FILE*  ofile = create_temp_output(filename, &temp);
+
+    try
+    {
+        writer(ofile);
+    }
+    catch (...)
+    {
+        discard_temp_output(ofile, temp);
+        throw;
+    }
+
+    commit_temp_output(ofile, temp, filename);
+}
+//=============================================================================
+
 
 //=============================================================================
 // write_output_header() - Writes the intial lines of the output file
@@ -279,9 +703,27 @@ void write_output_header(FILE* ofile)
     fprintf(ofile, "// This file was auto-generated by xlate_vreg v%s\n", REVISION);
     fprintf(ofile, "//            -->  DO NOT EDIT!  <-- \n");
     fprintf(ofile, "//=====================================================\n");
-    fprintf(ofile, "#ifndef _FPGA_REG_H\n");
-    fprintf(ofile, "#define _FPGA_REG_H\n");
+    // With more than one address space, each header has a guard of its own
+    string guard = "_FPGA_REG_H";
+    if (multiple_spaces)
+    {
+        guard = "_FPGA_REG_" + address_space_ident(current_space) + "_H";
+        for (auto& c : guard) c = toupper(c);
+        fprintf(ofile, "// Address space: %s\n", current_space.c_str());
+    }
+
+    fprintf(ofile, "#ifndef %s\n", guard.c_str());
+    fprintf(ofile, "#define %s\n", guard.c_str());
     fprintf(ofile, "\n\n");
+
+    // The optional emitters generate code that needs fixed-width types
+    if (make_struct || reset_image || make_shadow || make_snapshot || make_dump_plan || make_name_table
+     || has_init_script)
+    {
+        fprintf(ofile, "#include <stdint.h>\n");
+        fprintf(ofile, "#include <stddef.h>\n");
+        fprintf(ofile, "\n\n");
+    }
 }
 //=============================================================================
 
@@ -297,25 +739,350 @@ void write_output_footer(FILE* ofile)
 
 
 //=============================================================================
-// write_registers() - Writes the register definitions for a given connection
+// is_omitted() - Returns true if a connection has no register source file
+//=============================================================================
+bool is_omitted(const connection_t& conn)
+{
+    return conn.filename.empty() || conn.filename == "omit";
+}
+//=============================================================================
+
+
+//=============================================================================
+// register_key() - Returns the key that a connection's parsed registers are
+//                  cached under.  The same file can be parsed with different
+//                  prefixes
+//=============================================================================
+string register_key(const connection_t& conn)
+{
+    return absolute_path(conn.filename) + '\n' + conn.prefix;
+}
+//=============================================================================
+
+
+//=============================================================================
+// make_jobs() - Returns a pipeline job for every connection that gets written
+//               to the output file, in address order.  Connections whose
+//               parsed registers are in the cache are filled in from it
+//=============================================================================
+vector<pipeline_job_t> make_jobs()
+{
+    map<uint64_t, connection_t*> by_address;
+    vector<pipeline_job_t>       jobs;
+
+    // As in reorder_connections(), the last connection at an address wins
+    for (auto& c : connection) by_address[c.second.address] = &c.second;
+
+    for (auto& e : by_address)
+    {
+        connection_t&  conn = *e.second;
+        pipeline_job_t job  = {&conn, false, false, {0, 0, 0}};
+
+        // If we're skipping this file, there's nothing to do
+        if (is_omitted(conn)) continue;
+
+        // If we have already parsed this version of the file, use it
+        auto cached = register_cache.empty() ? nullptr : register_cache.find(register_key(conn), conn.filename);
+        if (cached)
+        {
+            conn.regs    = cached->regs;
+            conn.strings = cached->strings;
+            job.cached   = true;
+        }
+
+        jobs.push_back(job);
+    }
+
+    return jobs;
+}
+//=============================================================================
+
+
+//=============================================================================
+// prefetch_sources() - Starts reading every register source file in the 
+//                      background, so that waiting on one file overlaps with
+//                      parsing the ones before it.  There's no need to read
+//                      files whose registers came from the cache
+//=============================================================================
+void prefetch_sources(const vector<pipeline_job_t>& jobs)
+{
+    vector<string> filenames;
+
+    for (auto& job : jobs)
+    {
+        if (!job.cached) filenames.push_back(job.conn->filename);
+    }
+
+    prefetcher.start(filenames);
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_connection_preamble() - Writes what comes before the registers of a
+//                               connection, and returns the name of the base
+//                               macro that register constants are relative
+//                               to, or "" if they're absolute
+//=============================================================================
+string write_connection_preamble(const connection_t& conn, FILE* ofile)
+{
+    // In relative mode, every constant is an offset from a single base macro
+    if (!relative) return "";
+
+    string base_macro = connection_ident(conn) + "_BASE";
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Connection:  %s\n", conn.name.c_str());
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#define %-60s 0x%016xULL\n\n\n", base_macro.c_str(), (uint32_t)conn.address);
+    return base_macro;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_connection_extras() - Writes the optional per-connection sections
+//                             that come after the registers of a connection
+//=============================================================================
+void write_connection_extras(const connection_t& conn, FILE* ofile)
+{
+    // If the user wants a struct overlay of the registers, write it
+    if (make_struct) write_struct_overlay(ofile, conn.regs, connection_ident(conn));
+
+    // If the user wants a reset image of the registers, write it
+    if (reset_image) write_reset_image(ofile, conn.regs, connection_ident(conn));
+
+    // If the user wants shadow registers and accessors, write them
+    if (make_shadow) write_shadow_registers(ofile, conn.regs, connection_ident(conn));
+
+    // If the user wants a snapshot decoder, write it
+    if (make_snapshot) write_snapshot_decoder(ofile, conn.regs, connection_ident(conn));
+
+    // If the user wants a burst read plan for register dumps, write it
+    if (make_dump_plan) write_burst_plan(ofile, conn.regs, connection_ident(conn), dump_gap);
+}
+//=============================================================================
+
+
+//=============================================================================
+// parse_and_render() - Runs the register file of every connection through
+//                      the read/parse/render pipeline, writing the register
+//                      definitions of each connection to "ofile" in address
+//                      order
+//=============================================================================
+void parse_and_render(FILE* ofile)
+{
+    pipeline_renderer_t renderer;
+    string              base_macro;
+
+    // Find out which files we need, and start reading them
+    vector<pipeline_job_t> jobs = make_jobs();
+    prefetch_sources(jobs);
+
+    // A connection may start with its base address macro
+    renderer.begin = [&](const pipeline_job_t& job)
+    {
+        base_macro = write_connection_preamble(*job.conn, ofile);
+    };
+
+    // Every register is rendered as soon as it has been parsed
+    renderer.reg = [&](const pipeline_job_t& job, const vreg_t& reg)
+    {
+        write_register_define(ofile, reg, job.conn->address, base_macro, with_masks);
+    };
+
+    // The optional sections need all of a connection's registers
+    renderer.end = [&](const pipeline_job_t& job)
+    {
+        write_connection_extras(*job.conn, ofile);
+    };
+
+    run_pipeline(jobs, prefetcher, renderer, &pipeline_stats, &diagnostics);
+
+    // If there were problems anywhere in the inputs, report every one of them
+    diagnostics.check();
+
+    // Remember what each of the files we parsed held
+    for (auto& job : jobs)
+    {
+        connection_t& conn = *job.conn;
+        if (!job.cached && job.stamped)
+            register_cache.store(register_key(conn), job.stamp, {conn.regs, conn.strings});
+    }
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_trace_decoder() - Writes the trace decoding tool next to the C++
+//                         access library.  "regs.hpp" gets "regs_trace.cpp"
+//=============================================================================
+void write_trace_decoder()
+{
+    // The tool includes the library from the same directory
+    string library = space_file(lib_file);
+    size_t slash   = library.find_last_of('/');
+    string include = (slash == string::npos) ? library : library.substr(slash + 1);
+
+    write_output(strip_extension(library) + "_trace.cpp", [&](FILE* ofile)
+    {
+        write_trace_tool(ofile, include, REVISION);
+    });
+}
+//=============================================================================
+
+
+//=============================================================================
+// depfile_path() - Escapes a path the way Make and Ninja expect to find it in
+//                  a dependency file
+//=============================================================================
+string depfile_path(const string& path)
+{
+    string result;
+
+    for (char c : path)
+    {
+        if (c == ' ' || c == '#') result += '\\';
+        if (c == '$') result += '$';
+        result += c;
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_depfile() - Writes a Make/Ninja dependency file that says the output
+//                   file depends on the address map, the config file (and the
+//                   files it includes), and every register source file
 //=============================================================================
-void write_registers(connection_t& conn, FILE* ofile)
+void write_depfile()
 {
-    // If we're skipping this file, just return
-    if (conn.filename.empty() || conn.filename == "omit") return;
+    vector<string>   depends = {input_file, config_file};
+    std::set<string> seen(depends.begin(), depends.end());
 
-    // Get a handy pointer to the filename
-    const char* fn = conn.filename.c_str();
+    // The config file itself is already in the list under its own name
+    seen.insert(absolute_path(config_file));
+    for (auto& f : config_files) if (seen.insert(f).second) depends.push_back(f);
 
-    // Open the input file and complain if we can't
-    FILE* ifile = fopen(fn, "r");
-    if (ifile == nullptr) throwRuntime("can't open %s", fn);
-    
-    // Parse the verilog registers and output C/C++ definitions
-    parse_verilog_regs(ifile, conn.address, conn.prefix, ofile);
+    // Every register source file that was read, whether or not it was cached
+    for (auto& c : reorder_connections())
+    {
+        const connection_t& conn = c.second;
+        if (!is_omitted(conn) && seen.insert(conn.filename).second) depends.push_back(conn.filename);
+    }
 
-    // We're done with the input file
-    fclose(ifile);
+    write_output(space_file(dep_file), [&](FILE* ofile)
+    {
+        fprintf(ofile, "%s:", depfile_path(space_file(output_file)).c_str());
+        for (auto& d : depends) fprintf(ofile, " \\\n  %s", depfile_path(d).c_str());
+        fprintf(ofile, "\n");
+    });
+}
+//=============================================================================
+
+
+
+//=============================================================================
+// show_statistics() - Reports the size of the parsed register model, what its
+//                     strings cost in allocations, how long it took to parse
+//                     and render, our peak memory usage, and how busy each
+//                     stage of the pipeline was
+//=============================================================================
+void show_statistics(double parse_time, double render_time)
+{
+    std::set<const CStringArena*> arenas;
+    size_t registers = 0, fields = 0, requests = 0, heap_requests = 0, strings = 0, bytes = 0, blocks = 0;
+    rusage usage;
+
+    for (auto& c : connection)
+    {
+        registers += c.second.regs.size();
+        for (auto& reg : c.second.regs) fields += reg.field.size();
+
+        // A file that is parsed once is shared by the connections that use it
+        auto arena = c.second.strings.get();
+        if (arena == nullptr || !arenas.insert(arena).second) continue;
+        requests      += arena->requests();
+        heap_requests += arena->heap_requests();
+        strings       += arena->strings();
+        bytes         += arena->bytes();
+        blocks        += arena->blocks();
+    }
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(stderr_file, "registers:     %zu (%zu fields)\n", registers, fields);
+    fprintf(stderr_file, "strings:       %zu interned, %zu distinct, %zu bytes in %zu blocks\n",
+            requests, strings, bytes, blocks);
+    fprintf(stderr_file, "allocations:   %zu blocks and %zu index entries, instead of %zu std::string heap allocations\n",
+            blocks, strings, heap_requests);
+    fprintf(stderr_file, "pipeline time: %.2f ms\n", parse_time);
+    fprintf(stderr_file, "output time:   %.2f ms\n", render_time);
+    fprintf(stderr_file, "peak RSS:      %ld KB (whole process)\n", usage.ru_maxrss);
+
+    // If the pipeline ran, show where each stage spent its time
+    const pipeline_stats_t& ps = pipeline_stats;
+    if (!ps.ran) return;
+
+    fprintf(stderr_file, "\n");
+    if (!ps.threaded)
+    {
+        fprintf(stderr_file, "single CPU: read, parse and render stages ran inline\n");
+        return;
+    }
+
+    fprintf(stderr_file, "stage        busy ms   waiting for input ms   waiting for output ms\n");
+    fprintf(stderr_file, "read       %9.2f   %20s   %21.2f\n", ps.read_ms, "-", ps.chunks.full_wait_ms);
+    fprintf(stderr_file, "parse      %9.2f   %20.2f   %21.2f\n", ps.parse_ms, ps.chunks.empty_wait_ms, ps.regs.full_wait_ms);
+    fprintf(stderr_file, "render     %9.2f   %20.2f   %21s\n", ps.render_ms, ps.regs.empty_wait_ms, "-");
+    fprintf(stderr_file, "\n");
+
+    auto show_queue = [](const char* name, const queue_stats_t& q, size_t capacity)
+    {
+        double depth = q.pushes ? (double)q.depth_sum / q.pushes : 0;
+        fprintf(stderr_file, "%-13s  %8lu items, average depth %5.1f of %zu, full %lu times, empty %lu times\n",
+                name, q.pushes, depth, capacity, q.full_waits, q.empty_waits);
+    };
+
+    show_queue("read->parse",   ps.chunks, ps.chunk_capacity);
+    show_queue("parse->render", ps.regs,   ps.reg_capacity);
+}
+//=============================================================================
+
+
+//=============================================================================
+// select_address_spaces() - Returns the address spaces we're generating, and
+//                           drops every other space from "connection"
+//=============================================================================
+vector<string> select_address_spaces()
+{
+    vector<string> spaces = address_spaces(connection);
+
+    // If the user wants just one address space, forget the others
+    if (!only_space.empty())
+    {
+        if (std::find(spaces.begin(), spaces.end(), only_space) == spaces.end())
+        {
+            throwRuntime("address space %s isn't in %s", only_space.c_str(), input_file.c_str());
+        }
+
+        for (auto it = connection.begin(); it != connection.end();)
+        {
+            if (it->second.space == only_space)
+                ++it;
+            else
+                it = connection.erase(it);
+        }
+
+        spaces = {only_space};
+    }
+
+    // An empty address map still gets an (empty) output file
+    if (spaces.empty()) spaces.push_back("");
+
+    multiple_spaces = (spaces.size() > 1);
+    return spaces;
 }
 //=============================================================================
 
@@ -325,14 +1092,21 @@ void write_registers(connection_t& conn, FILE* ofile)
 //=============================================================================
 void execute()
 {
+    // Nothing has gone wrong yet
+    diagnostics.clear();
+
     // Build our "connection map" from the input file
-    parse_address_map(input_file, &connection);
+    read_address_map(input_file);
+
+    // Find out which address spaces we're generating output for
+    vector<string> spaces = select_address_spaces();
 
     // If the user just wants to see the connection names, show them
     if (show_names)
     {
-        show_connection_names();
-        exit(0);
+        diagnostics.check();
+        show_connection_names(spaces);
+        return;
     }
 
     // Read our configuration file
@@ -340,26 +1114,213 @@ void execute()
 
     // Fill in fields in the connection map from matching names in the "src_map"
     merge_maps();
-    
+
+    // Each address space gets output files of its own.  A register file is
+    // only parsed for the first space that uses it, after that its registers
+    // come from the register cache
+    map<string, connection_t> all_connections;
+    all_connections.swap(connection);
+    for (auto& space : spaces)
+    {
+        current_space = space;
+        for (auto& c : all_connections) if (c.second.space == space) connection.insert(c);
+        generate();
+        connection.clear();
+    }
+}
+//=============================================================================
+
+
+//=============================================================================
+// generate() - Writes the output files for the connections in "connection",
+//              which are the address space in "current_space"
+//=============================================================================
+void generate()
+{
     // Create the output file
-    FILE* ofile = create_output_file(output_file);
+    string temp_file;
+    FILE*  ofile = create_temp_output(space_file(output_file), &temp_file);
+    double parse_start, parse_time, render_start;
+    vector<init_write_t>        init_sequence;
+    map<uint64_t, connection_t> reordered;
+
+    try
+    {
+        // Write the header to the output file
+        write_output_header(ofile);
+
+        // If we're writing struct overlays, they need some support
+        if (make_struct) write_struct_preamble(ofile);
+
+        // If we're writing reset images or burst plans, they need some support
+        if (reset_image || make_dump_plan) write_burst_preamble(ofile);
+
+        // Read, parse and write the register definitions for every connection
+        parse_start    = monotonic_ms();
+        pipeline_stats = pipeline_stats_t();
+        parse_and_render(ofile);
+        parse_time     = monotonic_ms() - parse_start;
+        render_start   = monotonic_ms();
+        prefetcher.stop();
+
+        // Sort the connection list according to AXI address
+        reordered = reorder_connections();
+
+        // Compile the "init" script against the register definitions
+        if (has_init_script) init_sequence = compile_init_script(init_script, reordered);
+
+        // If the user wants a register map hash, write it
+        if (make_map_hash) write_map_hash(ofile, register_map_hash(reordered));
+
+        // If there's an initialization sequence, write it
+        write_init_sequence(ofile, init_sequence);
 
-    // Write the header to the output file
-    write_output_header(ofile);
+        // If the user wants a name lookup table, write it
+        if (make_name_table) write_name_table(ofile, reordered);
 
-    // Sort the connection list according to AXI address
-    auto reordered = reorder_connections();
+        // If any field has named values, write their lookup tables
+        write_enum_tables(ofile, reordered);
 
-    // Parse and write the register definitions for every connection
-    for (auto& entry : reordered)
+        // Output the footer and the end of the output file
+        write_output_footer(ofile);
+    }
+    catch (...)
     {
-        write_registers(entry.second, ofile);
+        discard_temp_output(ofile, temp_file);
+        throw;
     }
 
-    // Output the footer and the end of the output file
-    write_output_footer(ofile);
+    // We're done with the output file, move it into place
+    commit_temp_output(ofile, temp_file, space_file(output_file));
+
+    // If the user wants the register map hash for the RTL build, create it
+    if (!hash_verilog_file.empty()) write_output(space_file(hash_verilog_file), [&](FILE* ofile)
+    {
+        write_map_hash_verilog(ofile, register_map_hash(reordered), REVISION);
+    });
+
+    // If the user wants a C++ access library, create it
+    if (!lib_file.empty()) write_output(space_file(lib_file), [&](FILE* ofile)
+    {
+        write_access_library(ofile, reordered, REVISION, make_model, make_trace);
+    });
+
+    // Access tracing comes with a tool that decodes a saved trace
+    if (make_trace) write_trace_decoder();
 
-    // We're done with the output file, flush it to disk
-    if (ofile != stdout) fclose(ofile);
+    // If the build system wants to know what the output depends on, tell it
+    if (make_depfile) write_depfile();
+
+    // If the user wants to know where the time and memory went, tell them
+    if (show_stats) show_statistics(parse_time, monotonic_ms() - render_start);
 }
-//=============================================================================
\ No newline at end of file
+//=============================================================================
+
+
+//=============================================================================
+// reset_options() - Returns every command line option to its default, and
+//                   forgets the inputs of the previous request
+//=============================================================================
+void reset_options()
+{
+    prefetcher.stop();
+    connection.clear();
+    src_map.clear();
+    init_script.make_empty();
+    has_init_script = false;
+
+    input_file.clear();
+    output_file.clear();
+    config_file = "xlate_vreg.conf";
+    lib_file.clear();
+    hash_verilog_file.clear();
+    dep_file.clear();
+    only_space.clear();
+    current_space.clear();
+    config_files.clear();
+
+    show_names      = false;
+    relative        = false;
+    make_struct     = false;
+    with_masks      = false;
+    reset_image     = false;
+    make_shadow     = false;
+    make_snapshot   = false;
+    make_dump_plan  = false;
+    make_name_table = false;
+    make_model      = false;
+    make_trace      = false;
+    make_map_hash   = false;
+    show_stats      = false;
+    make_depfile    = false;
+    multiple_spaces = false;
+    dump_gap        = 0;
+}
+//=============================================================================
+
+
+//=============================================================================
+// handle_request() - Runs one command line on behalf of a client of the
+//                    generation daemon.  Anything that would have been written
+//                    to stdout is captured into "p_output", anything else that
+//                    would have gone to stderr into "p_messages", and an error
+//                    message is returned in "p_error"
+//=============================================================================
+int handle_request(const vector<string>& args, string* p_output, string* p_messages, string* p_error)
+{
+    vector<const char*> argv = {"xlate_vreg"};
+    char*               buffer = nullptr;
+    char*               messages = nullptr;
+    size_t              size = 0, messages_size = 0;
+    int                 status = 0;
+
+    // Build an argv[] from the client's arguments
+    for (auto& arg : args) argv.push_back(arg.c_str());
+    argv.push_back(nullptr);
+
+    // Capture whatever would be written to stdout and stderr
+    stdout_file = open_memstream(&buffer, &size);
+    stderr_file = open_memstream(&messages, &messages_size);
+    if (stdout_file == nullptr || stderr_file == nullptr)
+    {
+        if (stdout_file) fclose(stdout_file);
+        if (stderr_file) fclose(stderr_file);
+        free(buffer);
+        free(messages);
+        stdout_file = stdout;
+        stderr_file = stderr;
+        *p_error    = "can't capture output";
+        return 1;
+    }
+
+    // Run the command line with a clean set of options.  Parsed inputs are kept
+    try
+    {
+        reset_options();
+        parse_command_line(argv.data());
+        execute();
+    }
+    catch(const usage_error& e)
+    {
+        fputs(e.what(), stdout_file);
+        status = 1;
+    }
+    catch(const std::exception& e)
+    {
+        *p_error = e.what();
+        status   = 1;
+    }
+
+    // Hand the captured output to the caller
+    fclose(stdout_file);
+    fclose(stderr_file);
+    p_output->assign(buffer, size);
+    p_messages->assign(messages, messages_size);
+    free(buffer);
+    free(messages);
+    stdout_file = stdout;
+    stderr_file = stderr;
+
+    return status;
+}
+//=============================================================================
@@ -0,0 +1,52 @@
+#include "vreg_arena.h"
+
+// The size of a block of string storage
+static const size_t BLOCK_SIZE = 64 * 1024;
+
+
+//=============================================================================
+// allocate() - Reserves space for "length" bytes.  A string too big for a
+//              normal block gets a block of its own
+//=============================================================================
+char* CStringArena::allocate(size_t length)
+{
+    if (m_used + length > m_capacity)
+    {
+        size_t size = (length > BLOCK_SIZE) ? length : BLOCK_SIZE;
+        m_block.emplace_back(new char[size]);
+        m_used     = 0;
+        m_capacity = size;
+    }
+
+    char* result = m_block.back().get() + m_used;
+    m_used += length;
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// intern() - Returns the interned copy of a string, storing the string in the
+//            arena if this is the first time we've seen it
+//=============================================================================
+istr_t CStringArena::intern(const char* text, size_t length)
+{
+    static const size_t small_string = std::string().capacity();
+
+    ++m_requests;
+    if (length > small_string) ++m_heap_requests;
+
+    // If we already have this string, hand back the copy we have
+    auto it = m_index.find(std::string_view(text, length));
+    if (it != m_index.end()) return istr_t(it->data(), it->size());
+
+    // Otherwise, copy it (and a nul-terminator) into the arena
+    char* p = allocate(length + 1);
+    memcpy(p, text, length);
+    p[length] = 0;
+    m_bytes += length + 1;
+
+    m_index.insert(std::string_view(p, length));
+    return istr_t(p, length);
+}
+//=============================================================================
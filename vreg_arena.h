@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+
+//-----------------------------------------------------------------------------
+// istr_t - A string that has been interned in a CStringArena.  It's nothing
+//          but a pointer and a length, so it's free to copy, and it is valid
+//          for as long as the arena that holds it.  The text is always
+//          nul-terminated, so c_str() can go straight to printf
+//-----------------------------------------------------------------------------
+struct istr_t
+{
+    istr_t() : m_ptr(""), m_len(0) {}
+    istr_t(const char* ptr, uint32_t len) : m_ptr(ptr), m_len(len) {}
+
+    const char* c_str()          const {return m_ptr;}
+    size_t      size()           const {return m_len;}
+    size_t      length()         const {return m_len;}
+    bool        empty()          const {return m_len == 0;}
+    const char* begin()          const {return m_ptr;}
+    const char* end()            const {return m_ptr + m_len;}
+    char        operator[](size_t i) const {return m_ptr[i];}
+    std::string str()            const {return std::string(m_ptr, m_len);}
+
+    operator std::string_view()  const {return std::string_view(m_ptr, m_len);}
+
+    size_t find(char c, size_t from = 0) const
+    {
+        return std::string_view(*this).find(c, from);
+    }
+
+    size_t find(const char* s, size_t from = 0) const
+    {
+        return std::string_view(*this).find(s, from);
+    }
+
+    bool operator==(const istr_t& rhs) const
+    {
+        return (m_ptr == rhs.m_ptr && m_len == rhs.m_len) || std::string_view(*this) == std::string_view(rhs);
+    }
+
+    bool operator==(const char* rhs)        const {return std::string_view(*this) == rhs;}
+    bool operator==(const std::string& rhs) const {return std::string_view(*this) == rhs;}
+    bool operator!=(const istr_t& rhs)      const {return !(*this == rhs);}
+    bool operator!=(const char* rhs)        const {return !(*this == rhs);}
+    bool operator!=(const std::string& rhs) const {return !(*this == rhs);}
+    bool operator<(const istr_t& rhs)       const {return std::string_view(*this) < std::string_view(rhs);}
+
+protected:
+
+    const char* m_ptr;
+    uint32_t    m_len;
+};
+
+// Names are routinely glued together to make macro names
+inline std::string operator+(const istr_t& lhs, const char* rhs)        {return lhs.str() + rhs;}
+inline std::string operator+(const istr_t& lhs, const std::string& rhs) {return lhs.str() + rhs;}
+inline std::string operator+(const std::string& lhs, const istr_t& rhs) {return std::string(lhs).append(rhs.c_str(), rhs.size());}
+inline std::string operator+(const char* lhs, const istr_t& rhs)        {return lhs + rhs.str();}
+//-----------------------------------------------------------------------------
+
+
+//-----------------------------------------------------------------------------
+// CStringArena - Holds every string of a parsed register model.
+//
+// Strings are copied into large blocks, one after another, and a string that
+// has already been interned is handed back rather than stored again: a
+// register map repeats the same types, widths, reset values and field names
+// thousands of times over.  Nothing is freed until the arena is destroyed,
+// and then it's all freed at once
+//-----------------------------------------------------------------------------
+class CStringArena
+{
+public:
+
+    CStringArena() : m_used(0), m_capacity(0), m_requests(0), m_heap_requests(0), m_bytes(0) {}
+
+    // An arena owns the memory its strings point to, so it can't be copied
+    CStringArena(const CStringArena&) = delete;
+    CStringArena& operator=(const CStringArena&) = delete;
+
+    // Returns the interned copy of a string
+    istr_t intern(const char* text, size_t length);
+    istr_t intern(const char* text)        {return intern(text, strlen(text));}
+    istr_t intern(const std::string& text) {return intern(text.data(), text.size());}
+
+    // Statistics: strings requested, requests too long for a std::string to hold without a heap
+    // allocation, distinct strings stored, bytes stored, blocks allocated
+    size_t requests() const      {return m_requests;}
+    size_t heap_requests() const {return m_heap_requests;}
+    size_t strings()  const {return m_index.size();}
+    size_t bytes()    const {return m_bytes;}
+    size_t blocks()   const {return m_block.size();}
+
+protected:
+
+    // Reserves space for "length" bytes in the current block, or in a new one
+    char* allocate(size_t length);
+
+    // The blocks that hold the text, the amount of the last one used, and its size
+    std::vector<std::unique_ptr<char[]>> m_block;
+    size_t                               m_used, m_capacity;
+
+    // Every distinct string in the arena, for finding duplicates
+    std::unordered_set<std::string_view> m_index;
+
+    // Statistics
+    size_t                               m_requests, m_heap_requests, m_bytes;
+};
+//-----------------------------------------------------------------------------
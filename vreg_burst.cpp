@@ -0,0 +1,167 @@
+#include "vreg_burst.h"
+
+using std::vector;
+using std::string;
+
+
+//=============================================================================
+// write_burst_preamble() - Writes the types that every burst descriptor and
+//                          dump map depends on
+//=============================================================================
+void write_burst_preamble(FILE* ofile)
+{
+    fprintf(ofile, "typedef struct\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    uint32_t offset;    // Byte offset of the first word from the connection base\n");
+    fprintf(ofile, "    uint32_t count;     // Number of contiguous 32-bit words\n");
+    fprintf(ofile, "    uint32_t first;     // Index of the first word in the associated buffer\n");
+    fprintf(ofile, "} fpga_burst_t;\n");
+    fprintf(ofile, "\n");
+    fprintf(ofile, "typedef struct\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    const char* name;   // Register name\n");
+    fprintf(ofile, "    uint32_t    offset; // Byte offset of the register from the connection base\n");
+    fprintf(ofile, "    uint32_t    index;  // Index of the register's first word in the burst buffer\n");
+    fprintf(ofile, "    uint32_t    size;   // Register size in bits\n");
+    fprintf(ofile, "} fpga_dump_entry_t;\n");
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
+
+
+//=============================================================================
+// build_plan() - Builds the list of bursts that cover every register.
+//
+// Registers at contiguous offsets share a burst, and a burst is padded across
+// any gap that is no more than "max_gap" bytes
+//=============================================================================
+static vector<burst_t> build_plan(const vector<const vreg_t*>& sorted, uint32_t max_gap)
+{
+    vector<burst_t> result;
+    uint32_t        words = 0;
+
+    for (auto reg : sorted)
+    {
+        uint32_t start = reg->offset;
+        uint32_t end   = reg->offset + reg->size / 8;
+
+        // If this register is close enough to the current burst, extend the burst
+        if (!result.empty())
+        {
+            burst_t& burst     = result.back();
+            uint32_t burst_end = burst.offset + burst.count * 4;
+            if (start <= burst_end + max_gap)
+            {
+                if (end > burst_end)
+                {
+                    words      += (end - burst_end) / 4;
+                    burst.count = (end - burst.offset) / 4;
+                }
+                continue;
+            }
+        }
+
+        // Otherwise, this register starts a new burst
+        result.push_back({start, (end - start) / 4, words});
+        words += (end - start) / 4;
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// buffer_index() - Returns the index in the burst buffer of the word at the
+//                  specified offset
+//=============================================================================
+static uint32_t buffer_index(const vector<burst_t>& plan, uint32_t offset)
+{
+    for (auto& b : plan)
+    {
+        if (offset >= b.offset && offset < b.offset + b.count * 4)
+            return b.first + (offset - b.offset) / 4;
+    }
+
+    // We never get here: every register is covered by the plan
+    return 0;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_burst_plan() - Writes the burst read plan for a connection.
+//
+// The plan is the list of maximal contiguous ranges that cover every register
+// (optionally padded across small gaps) so that a full register dump takes
+// one DMA or wide read per range.  The bursts land back-to-back in a single
+// buffer, and the dump map says where each named register is in that buffer
+//=============================================================================
+void write_burst_plan(FILE* ofile, const vector<vreg_t>& regs, string ident, uint32_t max_gap)
+{
+    const char* id = ident.c_str();
+
+    // We need the registers in the order they appear in the address space
+    auto sorted = sort_by_offset(regs);
+
+    // If there are no registers, there's nothing to plan
+    if (sorted.empty()) return;
+
+    // Build the list of bursts
+    auto plan = build_plan(sorted, max_gap);
+
+    // Find out how many words the burst buffer needs
+    uint32_t words = plan.back().first + plan.back().count;
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Burst read plan: %s\n", id);
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#define %-60s %u\n", (ident + "_DUMP_BURSTS").c_str(), (uint32_t)plan.size());
+    fprintf(ofile, "#define %-60s %u\n", (ident + "_DUMP_WORDS" ).c_str(), words);
+    fprintf(ofile, "#define %-60s %u\n", (ident + "_DUMP_REGS"  ).c_str(), (uint32_t)sorted.size());
+    fprintf(ofile, "\n");
+
+    fprintf(ofile, "static const fpga_burst_t %s_dump_burst[] =\n{\n", id);
+    for (auto& b : plan)
+        fprintf(ofile, "    {0x%08x, %4u, %4u},\n", b.offset, b.count, b.first);
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const fpga_dump_entry_t %s_dump_map[] =\n{\n", id);
+    for (auto reg : sorted)
+    {
+        fprintf
+        (
+            ofile, "    {\"%s\", 0x%08x, %4u, %2u},\n",
+            reg->name.c_str(), reg->offset, buffer_index(plan, reg->offset), reg->size
+        );
+    }
+    fprintf(ofile, "};\n\n");
+
+    // This routine executes the plan through a pointer to the connection base
+    fprintf(ofile, "static inline void %s_dump_read(const volatile uint32_t* base, uint32_t* buffer)\n", id);
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    for (uint32_t b = 0; b < %s_DUMP_BURSTS; ++b)\n", id);
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        const fpga_burst_t* burst = &%s_dump_burst[b];\n", id);
+    fprintf(ofile, "        const volatile uint32_t* in = base + burst->offset / 4;\n");
+    fprintf(ofile, "        for (uint32_t i = 0; i < burst->count; ++i) buffer[burst->first + i] = in[i];\n");
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "}\n\n");
+
+    // This routine maps the burst buffer back to named registers
+    fprintf(ofile, "static inline void %s_dump_decode(const uint32_t* buffer,\n", id);
+    fprintf(ofile, "    void (*emit)(const char* name, uint32_t offset, uint64_t value, void* context), void* context)\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    for (uint32_t r = 0; r < %s_DUMP_REGS; ++r)\n", id);
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        const fpga_dump_entry_t* e = &%s_dump_map[r];\n", id);
+    fprintf(ofile, "        uint64_t value = buffer[e->index];\n");
+    fprintf(ofile, "        if (e->size == 64) value |= (uint64_t)buffer[e->index + 1] << 32;\n");
+    fprintf(ofile, "        emit(e->name, e->offset, value, context);\n");
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "}\n");
+
+    // Leave a couple of blank lines after every plan
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
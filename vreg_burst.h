@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "vreg_parser.h"
+
+// A run of 32-bit words at contiguous offsets
+struct burst_t
+{
+    uint32_t offset;
+    uint32_t count;
+    uint32_t first;
+};
+
+// Writes the types that burst descriptors and dump maps depend on
+void write_burst_preamble(FILE* ofile);
+
+// Writes a burst read plan and a dump routine for a connection
+void write_burst_plan(FILE* ofile, const std::vector<vreg_t>& regs, std::string ident,
+                      uint32_t max_gap = 0);
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include "vreg_diag.h"
+
+using std::vector;
+using std::string;
+
+
+//=============================================================================
+// format_diagnostic() - Formats a diagnostic the way compilers do, so that
+//                       editors can jump to it
+//=============================================================================
+string format_diagnostic(const diagnostic_t& d)
+{
+    string result = d.file;
+    if (d.line)   result += ":" + std::to_string(d.line);
+    if (d.column) result += ":" + std::to_string(d.column);
+    return result + ": " + d.message;
+}
+//=============================================================================
+
+
+//=============================================================================
+// error() - Records a problem
+//=============================================================================
+void CDiagnostics::error(const string& file, uint32_t line, uint32_t column, const string& message)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_list.push_back({file, line, column, message});
+}
+//=============================================================================
+
+
+//=============================================================================
+// count() - Returns the number of problems recorded so far
+//=============================================================================
+size_t CDiagnostics::count()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_list.size();
+}
+//=============================================================================
+
+
+//=============================================================================
+// list() - Returns every problem recorded.  Problems can be recorded by more
+//          than one thread, so they're sorted to make the order repeatable.
+//          A file that's used by more than one connection is parsed once for
+//          each, so the same problem is only listed once
+//=============================================================================
+vector<diagnostic_t> CDiagnostics::list()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    vector<diagnostic_t> result = m_list;
+
+    std::sort(result.begin(), result.end(), [](const diagnostic_t& a, const diagnostic_t& b)
+    {
+        if (a.file != b.file) return a.file < b.file;
+        if (a.line != b.line) return a.line < b.line;
+        if (a.column != b.column) return a.column < b.column;
+        return a.message < b.message;
+    });
+
+    auto same = [](const diagnostic_t& a, const diagnostic_t& b)
+    {
+        return a.file == b.file && a.line == b.line && a.column == b.column && a.message == b.message;
+    };
+    result.erase(std::unique(result.begin(), result.end(), same), result.end());
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// clear() - Forgets every problem
+//=============================================================================
+void CDiagnostics::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_list.clear();
+}
+//=============================================================================
+
+
+//=============================================================================
+// check() - Throws a diagnostics_error that describes every problem recorded,
+//           if there are any
+//=============================================================================
+void CDiagnostics::check()
+{
+    vector<diagnostic_t> problems = list();
+
+    if (problems.empty()) return;
+
+    string text = std::to_string(problems.size()) + (problems.size() == 1 ? " error" : " errors");
+    for (auto& d : problems) text += "\n" + format_diagnostic(d);
+
+    throw diagnostics_error(text, problems);
+}
+//=============================================================================
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+
+// One problem found in an input file.  A line or column of 0 means unknown
+struct diagnostic_t
+{
+    std::string file;
+    uint32_t    line;
+    uint32_t    column;
+    std::string message;
+};
+
+// Thrown when the inputs have problems.  what() describes every one of them
+struct diagnostics_error : public std::runtime_error
+{
+    diagnostics_error(const std::string& text, const std::vector<diagnostic_t>& list)
+        : std::runtime_error(text), problems(list) {}
+
+    std::vector<diagnostic_t> problems;
+};
+
+// Formats a diagnostic as "file:line:column: message"
+std::string format_diagnostic(const diagnostic_t& d);
+
+//-----------------------------------------------------------------------------
+// CDiagnostics - Collects the problems found in the inputs, so that parsing
+//                can carry on past an error and a single run can report
+//                every problem there is.  Problems may be recorded from
+//                more than one thread
+//-----------------------------------------------------------------------------
+class CDiagnostics
+{
+public:
+
+    // Records a problem
+    void error(const std::string& file, uint32_t line, uint32_t column, const std::string& message);
+
+    // The number of problems recorded so far
+    size_t count();
+
+    // Returns every problem recorded, sorted by file, line and column, with
+    // duplicates removed
+    std::vector<diagnostic_t> list();
+
+    // Forgets every problem
+    void clear();
+
+    // If any problems have been recorded, throws a diagnostics_error
+    void check();
+
+protected:
+
+    std::mutex                m_mutex;
+    std::vector<diagnostic_t> m_list;
+};
+//-----------------------------------------------------------------------------
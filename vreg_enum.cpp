@@ -0,0 +1,188 @@
+#include <algorithm>
+#include "vreg_enum.h"
+
+using std::vector;
+using std::string;
+using std::map;
+
+// A lookup table has to be at least this full to be laid out as a dense array
+static const uint32_t MIN_DENSITY = 4;
+
+// A dense array is never given more than this many entries
+static const uint64_t MAX_DENSE = 4096;
+
+
+//=============================================================================
+// is_dense() - Returns true if a field's values should be decoded with an
+//              array indexed by value, rather than a sorted table.  That's
+//              the case when the values are small enough, and packed tightly
+//              enough, that most of the array is in use
+//=============================================================================
+static bool is_dense(const vector<enum_value_t>& values, uint64_t max_value)
+{
+    return max_value < MAX_DENSE && max_value + 1 <= MIN_DENSITY * values.size();
+}
+//=============================================================================
+
+
+//=============================================================================
+// has_dense_table() - Returns true if a field's values get a dense table
+//=============================================================================
+static bool has_dense_table(const field_t& field)
+{
+    uint64_t max_value = 0;
+    for (auto& e : field.enums) if (e.value > max_value) max_value = e.value;
+    return is_dense(field.enums, max_value);
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_enum_table() - Writes the enum, the lookup table and the name()
+//                      function for a single field
+//=============================================================================
+static void write_enum_table(FILE* ofile, const vreg_t& reg, const field_t& field)
+{
+    // Sort the values, so that we know their range and can binary-search them
+    vector<enum_value_t> values = field.enums;
+    std::stable_sort(values.begin(), values.end(), [](const enum_value_t& a, const enum_value_t& b)
+    {
+        return a.value < b.value;
+    });
+
+    uint64_t max_value = values.back().value;
+    bool     dense     = is_dense(values, max_value);
+    char     text[1024];
+
+    // The macros already use REG_FIELD, so the namespace is REG_FIELD_enum
+    fprintf(ofile, "    namespace %s_%s_enum\n", reg.name.c_str(), field.name.c_str());
+    fprintf(ofile, "    {\n");
+
+    // The values, in the order they were defined
+    fprintf(ofile, "        enum value_t : unsigned long long\n");
+    fprintf(ofile, "        {\n");
+    for (auto& e : field.enums)
+    {
+        snprintf(text, sizeof text, "%s = 0x%lx,", e.name.c_str(), e.value);
+        if (e.desc.empty())
+            fprintf(ofile, "            %s\n", text);
+        else
+            fprintf(ofile, "            %-40s // %s\n", text, e.desc.c_str());
+    }
+    fprintf(ofile, "        };\n\n");
+
+    // A dense table has a slot for every value from 0 to the largest
+    if (dense)
+    {
+        fprintf(ofile, "        constexpr const char* table[%lu] =\n", max_value + 1);
+        fprintf(ofile, "        {");
+        auto it = values.begin();
+        for (uint64_t v = 0; v <= max_value; ++v)
+        {
+            if (v % 4 == 0) fprintf(ofile, "\n            ");
+            if (it != values.end() && it->value == v)
+                fprintf(ofile, "\"%s\", ", (it++)->name.c_str());
+            else
+                fprintf(ofile, "nullptr, ");
+        }
+        fprintf(ofile, "\n        };\n\n");
+
+        fprintf(ofile, "        constexpr const char* name(unsigned long long value)\n");
+        fprintf(ofile, "        {\n");
+        fprintf(ofile, "            return value <= 0x%lx ? table[value] : nullptr;\n", max_value);
+        fprintf(ofile, "        }\n");
+    }
+
+    // A sparse table holds only the values that have names, sorted by value
+    else
+    {
+        fprintf(ofile, "        constexpr sparse_entry_t table[%lu] =\n", values.size());
+        fprintf(ofile, "        {\n");
+        for (auto& e : values) fprintf(ofile, "            {0x%lx, \"%s\"},\n", e.value, e.name.c_str());
+        fprintf(ofile, "        };\n\n");
+
+        fprintf(ofile, "        constexpr const char* name(unsigned long long value)\n");
+        fprintf(ofile, "        {\n");
+        fprintf(ofile, "            return find(table, %lu, value);\n", values.size());
+        fprintf(ofile, "        }\n");
+    }
+
+    fprintf(ofile, "    }\n");
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_enum_tables() - Writes a constexpr enum for every field that has
+//                       "@enum" values, along with a name() function that
+//                       turns a value of the field back into its name.
+//
+// Each field gets the table layout that suits its values.  If they're small
+// and closely packed, name() is a single indexed load from an array with a
+// slot for every value.  Otherwise it's a binary search of a table of just
+// the values that have names
+//=============================================================================
+void write_enum_tables(FILE* ofile, const map<uint64_t, connection_t>& connections)
+{
+    vector<std::pair<const vreg_t*, const field_t*>> fields;
+
+    // Find every field that has named values
+    for (auto& c : connections)
+    {
+        for (auto& reg : c.second.regs)
+        {
+            for (auto& f : reg.field) if (!f.enums.empty()) fields.push_back({&reg, &f});
+        }
+    }
+
+    // If there are no named values, there's nothing to write
+    if (fields.empty()) return;
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Field value names: fpga_reg_enums::<REGISTER>_<FIELD>_enum::name(value)\n");
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#if defined(__cplusplus) && __cplusplus >= 201402L\n");
+    fprintf(ofile, "namespace fpga_reg_enums\n");
+    fprintf(ofile, "{\n");
+
+    // The binary search is only needed if some field has a sparse table.  The
+    // tables use built-in types, since <stdint.h> is only included when other
+    // emitters need it
+    bool sparse = std::any_of(fields.begin(), fields.end(), [](const std::pair<const vreg_t*, const field_t*>& f)
+    {
+        return !has_dense_table(*f.second);
+    });
+    if (sparse)
+    {
+        fprintf(ofile, "    struct sparse_entry_t\n");
+        fprintf(ofile, "    {\n");
+        fprintf(ofile, "        unsigned long long value;\n");
+        fprintf(ofile, "        const char*        name;\n");
+        fprintf(ofile, "    };\n\n");
+
+        fprintf(ofile, "    constexpr const char* find(const sparse_entry_t* table, unsigned count, unsigned long long value)\n");
+        fprintf(ofile, "    {\n");
+        fprintf(ofile, "        unsigned lo = 0, hi = count;\n");
+        fprintf(ofile, "        while (lo < hi)\n");
+        fprintf(ofile, "        {\n");
+        fprintf(ofile, "            unsigned mid = (lo + hi) / 2;\n");
+        fprintf(ofile, "            if (table[mid].value < value) lo = mid + 1; else hi = mid;\n");
+        fprintf(ofile, "        }\n");
+        fprintf(ofile, "        return (lo < count && table[lo].value == value) ? table[lo].name : nullptr;\n");
+        fprintf(ofile, "    }\n");
+    }
+
+    // Each table is separated from whatever comes before it by a blank line
+    for (size_t i = 0; i < fields.size(); ++i)
+    {
+        if (i || sparse) fprintf(ofile, "\n");
+        write_enum_table(ofile, *fields[i].first, *fields[i].second);
+    }
+
+    fprintf(ofile, "}\n");
+    fprintf(ofile, "#endif\n");
+
+    // Leave a couple of blank lines after the tables
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
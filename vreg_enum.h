@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include "amap_parser.h"
+
+// Writes a constexpr enum and a value-to-name lookup table for every field
+// that has "@enum" values.  Writes nothing if no field has any
+void write_enum_tables(FILE* ofile, const std::map<uint64_t, connection_t>& connections);
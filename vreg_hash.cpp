@@ -0,0 +1,99 @@
+#include "vreg_hash.h"
+
+using std::string;
+using std::map;
+
+
+//=============================================================================
+// hasher_t - A 64-bit FNV-1a hash that is fed integers one byte at a time,
+//            least significant first, so the result doesn't depend on the
+//            byte order or struct layout of the machine that runs xlate_vreg
+//=============================================================================
+struct hasher_t
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    void add_byte(uint8_t b) {h ^= b; h *= 0x100000001b3ULL;}
+
+    void add(uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i) add_byte((uint8_t)(value >> (8 * i)));
+    }
+
+    // A string is hashed with its terminating nul, so "AB","C" != "A","BC"
+    void add(std::string_view s)
+    {
+        for (char c : s) add_byte((uint8_t)c);
+        add_byte(0);
+    }
+};
+//=============================================================================
+
+
+//=============================================================================
+// register_map_hash() - Returns a hash of the full register model.
+//
+// The hash covers the name, address and size of every register, and the name,
+// width, position and type of each of its fields.  Registers are hashed in
+// address order, so reordering the Verilog source doesn't change the hash,
+// and descriptions and reset values are left out, so editing documentation
+// doesn't either.  Anything that changes how software must access the
+// registers does change it
+//=============================================================================
+uint64_t register_map_hash(const map<uint64_t, connection_t>& connections)
+{
+    hasher_t hasher;
+
+    for (auto& c : connections)
+    {
+        for (auto reg : sort_by_offset(c.second.regs))
+        {
+            hasher.add(reg->name);
+            hasher.add(c.second.address + reg->offset, 8);
+            hasher.add(reg->size, 1);
+            hasher.add(reg->field.size(), 4);
+            for (auto& f : reg->field)
+            {
+                hasher.add(f.name);
+                hasher.add(f.width, 1);
+                hasher.add(f.pos, 1);
+                hasher.add(f.type);
+            }
+        }
+    }
+
+    return hasher.h;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_map_hash() - Writes the register map hash.  The 32-bit version is for
+//                    an ID register that is only 32 bits wide
+//=============================================================================
+void write_map_hash(FILE* ofile, uint64_t hash)
+{
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Register map hash\n");
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#define %-60s 0x%016lxULL\n", "FPGA_REG_MAP_HASH", hash);
+    fprintf(ofile, "#define %-60s 0x%08x\n", "FPGA_REG_MAP_HASH32", (uint32_t)(hash ^ (hash >> 32)));
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_map_hash_verilog() - Writes the register map hash as a Verilog include
+//                            file, so the RTL can expose it in an ID register
+//=============================================================================
+void write_map_hash_verilog(FILE* ofile, uint64_t hash, const char* revision)
+{
+    fprintf(ofile, "//=====================================================\n");
+    fprintf(ofile, "// This file was auto-generated by xlate_vreg v%s\n", revision);
+    fprintf(ofile, "//            -->  DO NOT EDIT!  <-- \n");
+    fprintf(ofile, "//=====================================================\n");
+    fprintf(ofile, "localparam[63:0] REG_MAP_HASH   = 64'h%016lx;\n", hash);
+    fprintf(ofile, "localparam[31:0] REG_MAP_HASH32 = 32'h%08x;\n", (uint32_t)(hash ^ (hash >> 32)));
+}
+//=============================================================================
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include "amap_parser.h"
+
+// Returns a hash of the names, addresses and field specs of every register
+uint64_t register_map_hash(const std::map<uint64_t, connection_t>& connections);
+
+// Writes the register map hash as C constants
+void write_map_hash(FILE* ofile, uint64_t hash);
+
+// Writes the register map hash as Verilog localparams, for the RTL build
+void write_map_hash_verilog(FILE* ofile, uint64_t hash, const char* revision);
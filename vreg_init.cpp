@@ -0,0 +1,239 @@
+#include <set>
+#include <stdexcept>
+#include "vreg_init.h"
+
+using std::vector;
+using std::string;
+using std::map;
+using std::set;
+
+
+// A register and the address it lives at
+struct init_target_t
+{
+    const vreg_t* reg;
+    uint64_t      address;
+};
+
+
+//=============================================================================
+// init_error() - Throws an error about an "init" script statement
+//=============================================================================
+static void init_error(string message, const string& text)
+{
+    throw std::runtime_error("init: " + message + " in \"" + text + "\"");
+}
+//=============================================================================
+
+
+//=============================================================================
+// find_field() - Returns the field of a register with the specified name, or
+//                nullptr if the register has no such field
+//=============================================================================
+static const field_t* find_field(const vreg_t& reg, const string& name)
+{
+    for (auto& f : reg.field) if (f.name == name) return &f;
+    return nullptr;
+}
+//=============================================================================
+
+
+//=============================================================================
+// compile_init_script() - Resolves every statement of an "init" script against
+//                         the register model and returns the register writes
+//                         that carry them out, in order.
+//
+// A statement is either "REGISTER.field = value" or "REGISTER = value", where
+// REGISTER is a register name as it appears in the header.  Consecutive field
+// writes to the same register are merged into a single write, unless a field
+// is written twice (e.g., a reset pulse), which starts a new write.  The bits
+// that a merged write doesn't set come from the last value written to that
+// register by the script, or from its reset value, with any W1C/W1S bits
+// written as zero
+//=============================================================================
+vector<init_write_t> compile_init_script(CConfigScript& script,
+                                         const map<uint64_t, connection_t>& connections)
+{
+    map<string, init_target_t>    target;
+    map<const vreg_t*, uint64_t>  last_value;
+    vector<init_write_t>          result;
+    init_write_t                  current = {nullptr, 0, 0};
+    set<istr_t>                   fields_written;
+    bool                          whole_register = false;
+    string                        text;
+
+    // Build a map of every register name to its register and address
+    for (auto& c : connections)
+    {
+        for (auto& reg : c.second.regs)
+        {
+            target[reg.name.str()] = {&reg, c.second.address + reg.offset};
+        }
+    }
+
+    // This finishes the write that is currently being built
+    auto flush = [&]()
+    {
+        if (current.reg == nullptr) return;
+        result.push_back(current);
+        last_value[current.reg] = current.value;
+        current.reg = nullptr;
+    };
+
+    script.rewind();
+
+    while (script.get_next_line(nullptr, &text))
+    {
+        string statement, token;
+
+        // The statement may or may not have spaces around the '='
+        while (!(token = script.get_next_token()).empty()) statement += token;
+
+        // Split the statement into "REGISTER[.field]" and "value"
+        size_t equals = statement.find('=');
+        if (equals == string::npos) init_error("missing '='", text);
+        string lhs = statement.substr(0, equals);
+        string rhs = statement.substr(equals + 1);
+
+        // Split the left hand side into a register name and a field name
+        size_t dot = lhs.find('.');
+        string reg_name   = lhs.substr(0, dot);
+        string field_name = (dot == string::npos) ? "" : lhs.substr(dot + 1);
+
+        // Look up the register
+        auto it = target.find(reg_name);
+        if (it == target.end()) init_error("unknown register '" + reg_name + "'", text);
+        const vreg_t& reg = *it->second.reg;
+
+        // Look up the field, if there is one
+        const field_t* field = nullptr;
+        if (!field_name.empty())
+        {
+            field = find_field(reg, field_name);
+            if (field == nullptr) init_error("unknown field '" + field_name + "'", text);
+            if (!is_writable(*field)) init_error("field '" + field_name + "' isn't writable", text);
+        }
+
+        // Decode the value
+        char* end;
+        if (rhs.empty()) init_error("missing value", text);
+        uint64_t value = strtoull(rhs.c_str(), &end, 0);
+        if (*end) init_error("bad value '" + rhs + "'", text);
+
+        // Make sure the value fits in the field or register
+        uint32_t width = field ? field->width : reg.size;
+        if (width < 64 && (value >> width)) init_error("value doesn't fit in " + lhs, text);
+
+        // A whole-register write can only set the bits of writable fields.  A
+        // register without fields has no known layout, so any value goes
+        if (!field && !reg.field.empty() && (value & ~write_mask(reg)))
+            init_error("value sets bits of " + lhs + " that aren't writable", text);
+
+        // If this statement can't be merged into the current write, start a new one
+        bool merge = (current.reg == &reg) && field && !whole_register
+                  && fields_written.count(field->name) == 0;
+        if (!merge)
+        {
+            flush();
+            auto last = last_value.find(&reg);
+            current.reg     = &reg;
+            current.address = it->second.address;
+            current.value   = (last == last_value.end()) ? reset_value(reg) : last->second;
+            current.value  &= ~rmw_zero_mask(reg);
+            fields_written.clear();
+            whole_register = false;
+        }
+
+        // And apply this statement to the write
+        if (field)
+        {
+            current.value = (current.value & ~field_mask(*field)) | (value << field->pos);
+            fields_written.insert(field->name);
+        }
+        else
+        {
+            current.value  = value;
+            whole_register = true;
+        }
+    }
+
+    // Finish the last write
+    flush();
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_init_sequence() - Writes a compiled initialization sequence.
+//
+// Every write becomes one or two 32-bit data words, and writes to adjacent
+// addresses are batched into a single burst.  Boot code replays the sequence
+// by handing each burst to a block-write routine, with no name lookups or
+// read-modify-writes at run time
+//=============================================================================
+void write_init_sequence(FILE* ofile, const vector<init_write_t>& writes)
+{
+    struct init_burst_t {uint64_t address; uint32_t count, first;};
+
+    vector<init_burst_t> burst;
+    uint32_t             words = 0;
+
+    // If there are no writes, there's no sequence
+    if (writes.empty()) return;
+
+    // Batch writes to adjacent addresses
+    for (auto& w : writes)
+    {
+        uint32_t count = w.reg->size / 32;
+        if (!burst.empty() && burst.back().address + burst.back().count * 4 == w.address)
+            burst.back().count += count;
+        else
+            burst.push_back({w.address, count, words});
+        words += count;
+    }
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Initialization sequence\n");
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#define %-60s %u\n", "FPGA_INIT_BURSTS", (uint32_t)burst.size());
+    fprintf(ofile, "#define %-60s %u\n", "FPGA_INIT_WORDS", words);
+    fprintf(ofile, "\n");
+
+    fprintf(ofile, "typedef struct\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    uint64_t address;   // AXI address of the first word\n");
+    fprintf(ofile, "    uint32_t count;     // Number of contiguous 32-bit words\n");
+    fprintf(ofile, "    uint32_t first;     // Index of the first word in fpga_init_data\n");
+    fprintf(ofile, "} fpga_init_burst_t;\n\n");
+
+    fprintf(ofile, "static const fpga_init_burst_t fpga_init_burst[] =\n{\n");
+    for (auto& b : burst)
+        fprintf(ofile, "    {0x%016lxULL, %4u, %4u},\n", b.address, b.count, b.first);
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const uint32_t fpga_init_data[] =\n{\n");
+    for (auto& w : writes)
+    {
+        fprintf(ofile, "    0x%08x,    // %s\n", (uint32_t)w.value, w.reg->name.c_str());
+        if (w.reg->size == 64)
+            fprintf(ofile, "    0x%08x,    // %s[63:32]\n", (uint32_t)(w.value >> 32), w.reg->name.c_str());
+    }
+    fprintf(ofile, "};\n\n");
+
+    // This routine replays the sequence through a caller-supplied block write
+    fprintf(ofile, "static inline void fpga_init_replay(\n");
+    fprintf(ofile, "    void (*write_block)(uint64_t address, const uint32_t* data, uint32_t count, void* context), void* context)\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    for (uint32_t b = 0; b < FPGA_INIT_BURSTS; ++b)\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        const fpga_init_burst_t* burst = &fpga_init_burst[b];\n");
+    fprintf(ofile, "        write_block(burst->address, &fpga_init_data[burst->first], burst->count, context);\n");
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "}\n");
+
+    // Leave a couple of blank lines after the sequence
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include <vector>
+#include "amap_parser.h"
+#include "config_file.h"
+
+// One register write in a compiled initialization sequence
+struct init_write_t
+{
+    const vreg_t* reg;
+    uint64_t      address;
+    uint64_t      value;
+};
+
+// Resolves the symbolic writes of an "init" script into a list of register writes
+std::vector<init_write_t> compile_init_script(CConfigScript& script,
+                                              const std::map<uint64_t, connection_t>& connections);
+
+// Writes a compiled initialization sequence as a burst command stream
+void write_init_sequence(FILE* ofile, const std::vector<init_write_t>& writes);
@@ -0,0 +1,374 @@
+#include "vreg_lib.h"
+#include "vreg_model.h"
+#include "vreg_trace.h"
+
+using std::vector;
+using std::string;
+using std::map;
+
+
+//=============================================================================
+// This is the fixed part of the access library: register and field handles,
+// the backend interface with its mmap and memory implementations, and the
+// "device" class that provides typed access through a backend
+//=============================================================================
+static const char* library_text = R"(#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Unless access tracing is compiled in, the tracing hooks compile to nothing
+#ifndef FPGA_REG_TRACE_READ
+#define FPGA_REG_TRACE_READ(index, address, value)
+#define FPGA_REG_TRACE_WRITE(index, address, value)
+#define FPGA_REG_TRACE_READ_ADDR(address, value)
+#define FPGA_REG_TRACE_WRITE_ADDR(address, value)
+#endif
+
+namespace fpga_reg
+{
+    //-------------------------------------------------------------------------
+    // Handles for registers and fields.  The register map at the end of this
+    // file is made of these
+    //-------------------------------------------------------------------------
+    template <typename R> struct reg
+    {
+        uint64_t address;
+        uint32_t index;     // Index of the register in the register map
+    };
+
+    template <typename R, typename T> struct field
+    {
+        uint64_t address;   // Address of the register that contains the field
+        uint32_t index;     // Index of that register in the register map
+        uint32_t pos;       // Bit position of the field
+        R        mask;      // Mask of the field's bits, before shifting
+        R        rmw_zero;  // Bits written as zero by read-modify-write (W1C, W1S, etc)
+    };
+
+
+    //-------------------------------------------------------------------------
+    // backend - The interface to a register space.  Only read32() and write32()
+    //           are required, the rest can be overridden for speed
+    //-------------------------------------------------------------------------
+    class backend
+    {
+    public:
+        virtual ~backend() {}
+
+        virtual uint32_t read32(uint64_t address) = 0;
+        virtual void     write32(uint64_t address, uint32_t value) = 0;
+
+        virtual uint64_t read64(uint64_t address)
+        {
+            uint64_t lo = read32(address);
+            return lo | ((uint64_t)read32(address + 4) << 32);
+        }
+
+        virtual void write64(uint64_t address, uint64_t value)
+        {
+            write32(address,     (uint32_t)(value      ));
+            write32(address + 4, (uint32_t)(value >> 32));
+        }
+
+        virtual void read_block(uint64_t address, uint32_t* data, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i) data[i] = read32(address + 4 * i);
+        }
+
+        virtual void write_block(uint64_t address, const uint32_t* data, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i) write32(address + 4 * i, data[i]);
+        }
+    };
+
+
+    //-------------------------------------------------------------------------
+    // mmap_backend - Maps "size" bytes of a device file (/dev/mem, /dev/uio0,
+    //                etc) starting at "file_offset", and makes them visible at
+    //                AXI addresses "base" through "base + size - 1"
+    //-------------------------------------------------------------------------
+    class mmap_backend : public backend
+    {
+    public:
+        mmap_backend(const char* device, uint64_t base, size_t size, off_t file_offset)
+        {
+            m_fd = ::open(device, O_RDWR | O_SYNC);
+            if (m_fd < 0) throw std::runtime_error(std::string("can't open ") + device);
+            map(base, size, MAP_SHARED, file_offset);
+        }
+
+        ~mmap_backend()
+        {
+            if (m_ptr != MAP_FAILED) munmap(m_ptr, m_size);
+            if (m_fd >= 0) ::close(m_fd);
+        }
+
+        uint32_t read32(uint64_t address) override
+        {
+            return *(volatile uint32_t*)(m_ptr + (address - m_base));
+        }
+
+        void write32(uint64_t address, uint32_t value) override
+        {
+            *(volatile uint32_t*)(m_ptr + (address - m_base)) = value;
+        }
+
+        uint64_t read64(uint64_t address) override
+        {
+            return *(volatile uint64_t*)(m_ptr + (address - m_base));
+        }
+
+        void write64(uint64_t address, uint64_t value) override
+        {
+            *(volatile uint64_t*)(m_ptr + (address - m_base)) = value;
+        }
+
+        void read_block(uint64_t address, uint32_t* data, size_t count) override
+        {
+            volatile uint32_t* in = (volatile uint32_t*)(m_ptr + (address - m_base));
+            for (size_t i = 0; i < count; ++i) data[i] = in[i];
+        }
+
+        void write_block(uint64_t address, const uint32_t* data, size_t count) override
+        {
+            volatile uint32_t* out = (volatile uint32_t*)(m_ptr + (address - m_base));
+            for (size_t i = 0; i < count; ++i) out[i] = data[i];
+        }
+
+    protected:
+
+        mmap_backend() {}
+
+        void map(uint64_t base, size_t size, int flags, off_t file_offset)
+        {
+            m_base = base;
+            m_size = size;
+            m_ptr  = (uint8_t*)mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, m_fd, file_offset);
+            if (m_ptr == MAP_FAILED) throw std::runtime_error("mmap failed");
+        }
+
+        int      m_fd   = -1;
+        uint8_t* m_ptr  = (uint8_t*)MAP_FAILED;
+        uint64_t m_base = 0;
+        size_t   m_size = 0;
+    };
+
+
+    //-------------------------------------------------------------------------
+    // memory_backend - A register space in anonymous memory or, if a filename
+    //                  is given, in a plain file.  This is for testing
+    //-------------------------------------------------------------------------
+    class memory_backend : public mmap_backend
+    {
+    public:
+        memory_backend(uint64_t base, size_t size, const char* filename = nullptr)
+        {
+            if (filename == nullptr)
+            {
+                map(base, size, MAP_SHARED | MAP_ANONYMOUS, 0);
+                return;
+            }
+
+            m_fd = ::open(filename, O_RDWR | O_CREAT, 0666);
+            if (m_fd < 0) throw std::runtime_error(std::string("can't open ") + filename);
+            if (ftruncate(m_fd, size) != 0) throw std::runtime_error(std::string("can't size ") + filename);
+            map(base, size, MAP_SHARED, 0);
+        }
+    };
+
+
+    //-------------------------------------------------------------------------
+    // device - Typed register and field access through a backend
+    //-------------------------------------------------------------------------
+    class device
+    {
+    public:
+
+        explicit device(backend& b) : m_backend(b) {}
+
+        uint32_t read(reg<uint32_t> r)
+        {
+            uint32_t value = m_backend.read32(r.address);
+            FPGA_REG_TRACE_READ(r.index, r.address, value);
+            return value;
+        }
+
+        uint64_t read(reg<uint64_t> r)
+        {
+            uint64_t value = m_backend.read64(r.address);
+            FPGA_REG_TRACE_READ(r.index, r.address, value);
+            return value;
+        }
+
+        void write(reg<uint32_t> r, uint32_t value)
+        {
+            FPGA_REG_TRACE_WRITE(r.index, r.address, value);
+            m_backend.write32(r.address, value);
+        }
+
+        void write(reg<uint64_t> r, uint64_t value)
+        {
+            FPGA_REG_TRACE_WRITE(r.index, r.address, value);
+            m_backend.write64(r.address, value);
+        }
+
+        // Reads a single field
+        template <typename R, typename T> T get(const field<R, T>& f)
+        {
+            return (T)((read(reg<R>{f.address, f.index}) >> f.pos) & f.mask);
+        }
+
+        // Sets a single field with a read-modify-write of its register
+        template <typename R, typename T> void set(const field<R, T>& f, typename std::common_type<T>::type value)
+        {
+            R v = read(reg<R>{f.address, f.index});
+            v &= ~((f.mask << f.pos) | f.rmw_zero);
+            v |= ((R)value & f.mask) << f.pos;
+            write(reg<R>{f.address, f.index}, v);
+        }
+
+        // Reads "count" 32-bit registers.  Runs of consecutive addresses are
+        // handed to the backend as a single block read
+        void read(const uint64_t* address, uint32_t* value, size_t count)
+        {
+            for (size_t i = 0, run; i < count; i += run)
+            {
+                for (run = 1; i + run < count; ++run)
+                    if (address[i + run] != address[i] + 4 * run) break;
+                m_backend.read_block(address[i], value + i, run);
+            }
+            for (size_t i = 0; i < count; ++i) FPGA_REG_TRACE_READ_ADDR(address[i], value[i]);
+        }
+
+        // Writes "count" 32-bit registers.  Runs of consecutive addresses are
+        // handed to the backend as a single block write
+        void write(const uint64_t* address, const uint32_t* value, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i) FPGA_REG_TRACE_WRITE_ADDR(address[i], value[i]);
+            for (size_t i = 0, run; i < count; i += run)
+            {
+                for (run = 1; i + run < count; ++run)
+                    if (address[i + run] != address[i] + 4 * run) break;
+                m_backend.write_block(address[i], value + i, run);
+            }
+        }
+
+    protected:
+
+        backend& m_backend;
+    };
+
+)";
+//=============================================================================
+
+
+//=============================================================================
+// value_type() - Returns the smallest unsigned type that holds a field
+//=============================================================================
+static const char* value_type(uint32_t width)
+{
+    if (width <= 8 ) return "uint8_t";
+    if (width <= 16) return "uint16_t";
+    if (width <= 32) return "uint32_t";
+    return "uint64_t";
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_register_map() - Writes the register and field handles for one
+//                        connection
+//=============================================================================
+static void write_register_map(FILE* ofile, const connection_t& conn, string ident,
+                               uint32_t* p_index)
+{
+    fprintf(ofile, "    namespace %s\n", ident.c_str());
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        constexpr uint64_t BASE = 0x%016lxULL;\n", conn.address);
+
+    for (auto reg : sort_by_offset(conn.regs))
+    {
+        uint64_t    address = conn.address + reg->offset;
+        const char* rtype   = (reg->size == 64) ? "uint64_t" : "uint32_t";
+        uint32_t    index   = (*p_index)++;
+
+        fprintf(ofile, "\n");
+        fprintf(ofile, "        namespace %s\n", reg->short_name.c_str());
+        fprintf(ofile, "        {\n");
+        fprintf(ofile, "            constexpr reg<%s> REG {0x%016lxULL, %u};\n", rtype, address, index);
+
+        for (auto& f : reg->field)
+        {
+            fprintf
+            (
+                ofile,
+                "            constexpr field<%s, %s> %s {0x%016lxULL, %u, %u, 0x%lx, 0x%lx};\n",
+                rtype,
+                value_type(f.width),
+                f.name.c_str(),
+                address,
+                index,
+                f.pos,
+                field_mask(f) >> f.pos,
+                rmw_zero_mask(*reg)
+            );
+        }
+
+        fprintf(ofile, "        }\n");
+    }
+
+    fprintf(ofile, "    }\n\n");
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_access_library() - Writes a self-contained C++ register access
+//                          library: a pluggable backend (a memory-mapped
+//                          device file, or memory for testing), typed field
+//                          get/set, batched register access, and handles for
+//                          every register and field of every connection.
+//
+// If "with_model" is true, the library also gets an in-memory device model
+// backend for running driver tests without hardware.  If "with_trace" is true,
+// the library gets access counters and trace rings that a program turns on
+// by defining FPGA_REG_TRACE
+//=============================================================================
+void write_access_library(FILE* ofile, const map<uint64_t, connection_t>& connections,
+                          const char* revision, bool with_model, bool with_trace)
+{
+    uint32_t index = 0;
+
+    fprintf(ofile, "//=====================================================\n");
+    fprintf(ofile, "// This file was auto-generated by xlate_vreg v%s\n", revision);
+    fprintf(ofile, "//            -->  DO NOT EDIT!  <-- \n");
+    fprintf(ofile, "//=====================================================\n");
+    fprintf(ofile, "#pragma once\n");
+
+    // The device model needs a few more headers
+    if (with_model) write_model_includes(ofile);
+
+    // The tracing hooks have to be defined before the library uses them
+    if (with_trace) write_trace_support(ofile, connections);
+
+    // Write out the fixed portion of the library
+    fputs(library_text, ofile);
+
+    // Write the register map for every connection that has registers
+    for (auto& c : connections)
+    {
+        if (c.second.regs.empty()) continue;
+        write_register_map(ofile, c.second, connection_ident(c.second), &index);
+    }
+
+    // If the caller wants a device model, write it
+    if (with_model) write_device_model(ofile, connections);
+
+    fprintf(ofile, "}\n");
+}
+//=============================================================================
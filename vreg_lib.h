@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include "amap_parser.h"
+
+// Writes a C++ register access library for every connection
+void write_access_library(FILE* ofile, const std::map<uint64_t, connection_t>& connections,
+                          const char* revision, bool with_model = false, bool with_trace = false);
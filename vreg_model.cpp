@@ -0,0 +1,201 @@
+#include "vreg_model.h"
+
+using std::vector;
+using std::string;
+using std::map;
+
+
+//=============================================================================
+// This is the fixed part of the device model.  It's a backend of the access
+// library, so a driver test suite can run against it exactly as it would
+// run against the mmap backend
+//=============================================================================
+static const char* model_text = R"(
+    //-------------------------------------------------------------------------
+    // model_backend - A sparse, hash-based model of the register space.
+    //
+    // Registers start at their reset values.  Writes only change writable
+    // bits, W1C bits are cleared by writing 1, and W1S bits are set by writing
+    // 1.  Reads and writes of addresses that aren't registers read as zero and
+    // are discarded.  A callback can be attached to any register; a read
+    // callback can change the value that is read, and a write callback sees
+    // the value that was written.  peek() and poke() bypass all of this, so a
+    // test can set read-only status bits
+    //-------------------------------------------------------------------------
+    class model_backend : public backend
+    {
+    public:
+
+        typedef std::function<uint32_t(uint64_t address, uint32_t value)> read_callback;
+        typedef std::function<void(uint64_t address, uint32_t value)>     write_callback;
+
+        model_backend() {reset();}
+
+        // Returns every register to its reset value.  Callbacks are kept
+        void reset()
+        {
+            m_regs.clear();
+            m_regs.reserve(model_word_count);
+            for (size_t i = 0; i < model_word_count; ++i)
+            {
+                const model_word& w = model_words[i];
+                m_regs[w.address] = {w.reset, w.write_mask, w.w1c_mask, w.w1s_mask, false};
+            }
+            for (auto& c : m_read_callback ) m_regs[c.first].has_callback = true;
+            for (auto& c : m_write_callback) m_regs[c.first].has_callback = true;
+        }
+
+        uint32_t read32(uint64_t address) override
+        {
+            auto it = m_regs.find(address);
+            if (it == m_regs.end()) return 0;
+            uint32_t value = it->second.value;
+            if (it->second.has_callback)
+            {
+                auto cb = m_read_callback.find(address);
+                if (cb != m_read_callback.end()) value = cb->second(address, value);
+            }
+            return value;
+        }
+
+        void write32(uint64_t address, uint32_t value) override
+        {
+            auto it = m_regs.find(address);
+            if (it == m_regs.end()) return;
+            cell& c = it->second;
+            c.value = (c.value & ~c.write_mask) | (value & c.write_mask);
+            c.value &= ~(value & c.w1c_mask);
+            c.value |=  (value & c.w1s_mask);
+            if (c.has_callback)
+            {
+                auto cb = m_write_callback.find(address);
+                if (cb != m_write_callback.end()) cb->second(address, value);
+            }
+        }
+
+        // Attach callbacks to the 32-bit register at "address"
+        void on_read(uint64_t address, read_callback callback)
+        {
+            m_read_callback[address] = callback;
+            m_regs[address].has_callback = true;
+        }
+
+        void on_write(uint64_t address, write_callback callback)
+        {
+            m_write_callback[address] = callback;
+            m_regs[address].has_callback = true;
+        }
+
+        // Direct access to the stored value, ignoring masks and callbacks
+        uint32_t peek(uint64_t address) {auto it = m_regs.find(address); return it == m_regs.end() ? 0 : it->second.value;}
+        void     poke(uint64_t address, uint32_t value) {m_regs[address].value = value;}
+
+    protected:
+
+        struct cell
+        {
+            uint32_t value;
+            uint32_t write_mask;
+            uint32_t w1c_mask;
+            uint32_t w1s_mask;
+            bool     has_callback;
+        };
+
+        std::unordered_map<uint64_t, cell>           m_regs;
+        std::unordered_map<uint64_t, read_callback>  m_read_callback;
+        std::unordered_map<uint64_t, write_callback> m_write_callback;
+    };
+)";
+//=============================================================================
+
+
+//=============================================================================
+// type_mask() - Returns the mask of register bits in fields whose type
+//               contains the specified string (e.g., "1C" or "1S")
+//=============================================================================
+static uint64_t type_mask(const vreg_t& reg, const char* type)
+{
+    uint64_t result = 0;
+
+    for (auto& f : reg.field)
+    {
+        if (f.type.find(type) != string::npos) result |= field_mask(f);
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_model_includes() - Writes the #includes the device model needs
+//=============================================================================
+void write_model_includes(FILE* ofile)
+{
+    fprintf(ofile, "#include <functional>\n");
+    fprintf(ofile, "#include <unordered_map>\n");
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_device_model() - Writes a table of the reset value and write masks of
+//                        every 32-bit register word, followed by the model
+//                        backend that is initialized from it
+//=============================================================================
+void write_device_model(FILE* ofile, const map<uint64_t, connection_t>& connections)
+{
+    uint32_t count = 0;
+
+    fprintf(ofile, "    struct model_word\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        uint64_t address;\n");
+    fprintf(ofile, "        uint32_t reset;\n");
+    fprintf(ofile, "        uint32_t write_mask;\n");
+    fprintf(ofile, "        uint32_t w1c_mask;\n");
+    fprintf(ofile, "        uint32_t w1s_mask;\n");
+    fprintf(ofile, "    };\n\n");
+
+    fprintf(ofile, "    constexpr model_word model_words[] =\n");
+    fprintf(ofile, "    {\n");
+
+    for (auto& c : connections)
+    {
+        for (auto reg : sort_by_offset(c.second.regs))
+        {
+            uint64_t address = c.second.address + reg->offset;
+            uint64_t w1c     = type_mask(*reg, "1C");
+            uint64_t w1s     = type_mask(*reg, "1S");
+            uint64_t reset   = reset_value(*reg);
+            uint64_t wmask   = write_mask(*reg) & ~(w1c | w1s);
+
+            // A 64-bit register is modelled as two 32-bit words
+            for (int half = 0; half < reg->size / 32; ++half)
+            {
+                int shift = half * 32;
+                fprintf
+                (
+                    ofile, "        {0x%016lxULL, 0x%08x, 0x%08x, 0x%08x, 0x%08x},    // %s\n",
+                    address + half * 4,
+                    (uint32_t)(reset >> shift),
+                    (uint32_t)(wmask >> shift),
+                    (uint32_t)(w1c   >> shift),
+                    (uint32_t)(w1s   >> shift),
+                    reg->name.c_str()
+                );
+                ++count;
+            }
+        }
+    }
+
+    // An empty array isn't legal C++
+    if (count == 0) fprintf(ofile, "        {0, 0, 0, 0, 0}\n");
+
+    fprintf(ofile, "    };\n\n");
+    fprintf(ofile, "    constexpr size_t model_word_count = %u;\n", count);
+
+    // And write the model itself
+    fputs(model_text, ofile);
+    fprintf(ofile, "\n");
+}
+//=============================================================================
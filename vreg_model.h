@@ -0,0 +1,10 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include "amap_parser.h"
+
+// Writes the #includes that the device model depends on
+void write_model_includes(FILE* ofile);
+
+// Writes a sparse in-memory device model as a backend of the access library
+void write_device_model(FILE* ofile, const std::map<uint64_t, connection_t>& connections);
@@ -0,0 +1,236 @@
+#include <stdexcept>
+#include <algorithm>
+#include "vreg_names.h"
+
+using std::vector;
+using std::string;
+using std::map;
+
+// One name in the table
+struct name_entry_t
+{
+    string   name;
+    uint64_t address;
+    uint32_t spec;
+};
+
+
+//=============================================================================
+// name_hash() - Hashes a name with a seed.  This must produce exactly the
+//               same result as the "hash()" function in the generated code
+//=============================================================================
+static uint64_t name_hash(const char* s, uint64_t seed)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    while (*s)
+    {
+        h ^= (uint8_t)*s++;
+        h *= 0x100000001b3ULL;
+    }
+    return h ^ (h >> 29);
+}
+//=============================================================================
+
+
+//=============================================================================
+// collect_names() - Builds the list of every register and field name.
+//
+// Every name must be unique across all connections, because the table maps
+// a name to exactly one address
+//=============================================================================
+static vector<name_entry_t> collect_names(const map<uint64_t, connection_t>& connections)
+{
+    vector<name_entry_t>  result;
+    map<string, string>   owner;
+
+    // This adds a name to the result, complaining if it's already there
+    auto add = [&](const connection_t& conn, string name, uint64_t address, uint32_t spec)
+    {
+        auto it = owner.find(name);
+        if (it != owner.end())
+        {
+            throw std::runtime_error
+            (
+                "name '" + name + "' is defined by both " + it->second + " and " + conn.name
+            );
+        }
+        owner[name] = conn.name;
+        result.push_back({name, address, spec});
+    };
+
+    for (auto& c : connections)
+    {
+        const connection_t& conn = c.second;
+        for (auto& reg : conn.regs)
+        {
+            uint64_t address = conn.address + reg.offset;
+            add(conn, reg.name.str(), address, 0);
+            for (auto& f : reg.field)
+            {
+                add(conn, reg.name + "_" + f.name, address, (f.width << 24) | (f.pos << 16));
+            }
+        }
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// build_displacements() - Finds a displacement seed for every bucket such
+//                         that every name lands in its own slot.
+//
+// This is the "hash and displace" scheme: a name's bucket is selected with
+// seed 0, and its slot is selected with the seed of its bucket.  Buckets are
+// placed largest first, trying seeds until every name in the bucket lands in
+// a free slot.  On exit, "slot" maps each table slot to an index in "names"
+//=============================================================================
+static vector<uint32_t> build_displacements(const vector<name_entry_t>& names,
+                                            vector<uint32_t>* p_slot)
+{
+    uint32_t count   = names.size();
+    uint32_t buckets = count / 4 + 1;
+
+    vector<uint32_t>         result(buckets, 0);
+    vector<vector<uint32_t>> bucket(buckets);
+    vector<bool>             used(count, false);
+
+    // Distribute the names into their buckets
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        bucket[name_hash(names[i].name.c_str(), 0) % buckets].push_back(i);
+    }
+
+    // We're going to place the largest buckets first
+    vector<uint32_t> order;
+    for (uint32_t b = 0; b < buckets; ++b) order.push_back(b);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+    {
+        return bucket[a].size() > bucket[b].size();
+    });
+
+    p_slot->assign(count, 0);
+
+    for (uint32_t b : order)
+    {
+        vector<uint32_t> slots;
+
+        if (bucket[b].empty()) break;
+
+        // Try seeds until every name in this bucket lands in a free slot
+        for (uint32_t seed = 1; ; ++seed)
+        {
+            if (seed == 0x1000000) throw std::runtime_error("can't build name hash table");
+
+            slots.clear();
+            for (uint32_t i : bucket[b])
+            {
+                uint32_t s = name_hash(names[i].name.c_str(), seed) % count;
+                if (used[s] || std::find(slots.begin(), slots.end(), s) != slots.end()) break;
+                slots.push_back(s);
+            }
+
+            if (slots.size() == bucket[b].size())
+            {
+                result[b] = seed;
+                break;
+            }
+        }
+
+        // Claim the slots for this bucket's names
+        for (uint32_t i = 0; i < slots.size(); ++i)
+        {
+            used[slots[i]] = true;
+            (*p_slot)[slots[i]] = bucket[b][i];
+        }
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_name_table() - Writes a constexpr minimal perfect-hash table that maps
+//                      every register and field name to its address and spec.
+//
+// Lookup is one hash to find the bucket, one hash to find the slot, and one
+// string compare to confirm the name.  The table is built here, at generation
+// time, so there's no startup cost in the program that uses it
+//=============================================================================
+void write_name_table(FILE* ofile, const map<uint64_t, connection_t>& connections)
+{
+    vector<uint32_t> slot;
+
+    // Fetch every register and field name
+    auto names = collect_names(connections);
+
+    // If there are no names, there's no table
+    if (names.empty()) return;
+
+    // Find a displacement for every bucket
+    auto displacement = build_displacements(names, &slot);
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Register and field name table: fpga_reg_names::lookup(name)\n");
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#if defined(__cplusplus) && __cplusplus >= 201402L\n");
+    fprintf(ofile, "namespace fpga_reg_names\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    struct entry_t\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        const char* name;\n");
+    fprintf(ofile, "        uint64_t    address;\n");
+    fprintf(ofile, "        uint32_t    spec;\n");
+    fprintf(ofile, "    };\n\n");
+
+    fprintf(ofile, "    constexpr uint32_t count   = %u;\n", (uint32_t)names.size());
+    fprintf(ofile, "    constexpr uint32_t buckets = %u;\n\n", (uint32_t)displacement.size());
+
+    fprintf(ofile, "    constexpr uint32_t displacement[] =\n    {");
+    for (uint32_t i = 0; i < displacement.size(); ++i)
+    {
+        if (i % 8 == 0) fprintf(ofile, "\n        ");
+        fprintf(ofile, "%u, ", displacement[i]);
+    }
+    fprintf(ofile, "\n    };\n\n");
+
+    fprintf(ofile, "    constexpr entry_t table[] =\n    {\n");
+    for (uint32_t s : slot)
+    {
+        auto& e = names[s];
+        fprintf(ofile, "        {\"%s\", 0x%016lxULL, 0x%08x},\n", e.name.c_str(), e.address, e.spec);
+    }
+    fprintf(ofile, "    };\n\n");
+
+    fprintf(ofile, "    constexpr uint64_t hash(const char* s, uint64_t seed)\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        uint64_t h = 0xcbf29ce484222325ULL ^ seed;\n");
+    fprintf(ofile, "        while (*s)\n");
+    fprintf(ofile, "        {\n");
+    fprintf(ofile, "            h ^= (uint8_t)*s++;\n");
+    fprintf(ofile, "            h *= 0x100000001b3ULL;\n");
+    fprintf(ofile, "        }\n");
+    fprintf(ofile, "        return h ^ (h >> 29);\n");
+    fprintf(ofile, "    }\n\n");
+
+    fprintf(ofile, "    constexpr bool equal(const char* a, const char* b)\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        while (*a && *a == *b) ++a, ++b;\n");
+    fprintf(ofile, "        return *a == *b;\n");
+    fprintf(ofile, "    }\n\n");
+
+    fprintf(ofile, "    constexpr const entry_t* lookup(const char* name)\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        const uint32_t seed = displacement[hash(name, 0) %% buckets];\n");
+    fprintf(ofile, "        const entry_t& e    = table[hash(name, seed) %% count];\n");
+    fprintf(ofile, "        return equal(e.name, name) ? &e : nullptr;\n");
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "}\n");
+    fprintf(ofile, "#endif\n");
+
+    // Leave a couple of blank lines after the table
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
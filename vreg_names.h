@@ -0,0 +1,7 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include "amap_parser.h"
+
+// Writes a compile-time perfect-hash table of every register and field name
+void write_name_table(FILE* ofile, const std::map<uint64_t, connection_t>& connections);
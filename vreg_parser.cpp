@@ -1,6 +1,9 @@
 #include <vector>
 #include <string>
+#include <algorithm>
 #include <string.h>
+#include <ctype.h>
+#include <stdexcept>
 #include "vreg_parser.h"
 
 // Allow the convenient usage of STL containers 
@@ -8,31 +11,6 @@ using std::vector;
 using std::string;
 
 
-// We will keep a vector of various kinds of definitions.
-// Each entry in the vector is one of these
-struct entry_t
-{
-    string  key;
-    string  name;
-    string  width;
-    string  pos; 
-    string  type;
-    string  reset;
-    string  desc;
-    void clear()
-    {
-        key   = "";
-        name  = "";
-        width = "";
-        pos   = "";
-        type  = "";
-        reset = "";
-        desc  = "";
-    }
-};
-
-vector<entry_t> definition;
-
 
 //=============================================================================
 // chomp() - Chops the end-of-line character off the end of a buffer
@@ -50,112 +28,170 @@ static void chomp(char* p)
 
 
 //=============================================================================
-// decode_int() - Decodes a string to a 32-bit integer
+// skip_whitespace() - Skips over whitespace
 //=============================================================================
-static uint32_t decode_int(string input)
+static const char* skip_whitespace(const char* p)
 {
-    char    buffer[100], *out = buffer;
+    while (*p == ' ' || *p == 9) ++p;
+    return p;
+}
+//=============================================================================
+
 
-    // Get a pointer to the input string
-    const char* in = input.c_str();
+//=============================================================================
+// decode_digits() - Accumulates the digits of a number in the given radix,
+//                   ignoring underscores.  If "unknowns" is true, an 'x', 'z'
+//                   or '?' digit counts as zero.  Returns a pointer to the
+//                   first character that isn't a digit, and sets *p_overflow
+//                   if the value doesn't fit in 64 bits
+//=============================================================================
+static const char* decode_digits(const char* in, uint32_t radix, bool unknowns,
+                                 uint64_t* p_value, bool* p_overflow)
+{
+    uint64_t value = *p_value;
 
-    // Copy the input string to the buffer, removing underscores as we go
-    while ((out - buffer) < sizeof(buffer - 1))
+    while (true)
     {
-        if (*in == 0) break;
-        if (*in == '_')
+        uint32_t digit, c = *in;
+
+        if (c == '_')
         {
-            in++;
+            ++in;
             continue;
         }
-        *out++ = *in++;
-    }
 
-    // Nul-terminate the buffer
-    *out = 0;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            digit = (c | 0x20) - 'a' + 10;
+        else if (unknowns && ((c | 0x20) == 'x' || (c | 0x20) == 'z' || c == '?'))
+            digit = 0;
+        else
+            break;
 
-    // If there is a 'h in the string, it's in hex
-    in = strstr(buffer, "'h");
-    if (in) return strtoul(in+2, nullptr, 16);
+        if (digit >= radix) break;
 
-    // If there is a 'd in the string, it's in decimal
-    in = strstr(buffer, "'d");
-    if (in) return strtoul(in+2, nullptr, 10);
+        if (value > (UINT64_MAX - digit) / radix) *p_overflow = true;
+        value = value * radix + digit;
+        ++in;
+    }
 
-    // In all other cases, we won't assume we know the radix
-    return strtoul(buffer, nullptr, 0);
+    *p_value = value;
+    return in;
 }
 //=============================================================================
 
 
+//=============================================================================
+// decode_literal() - Decodes a Verilog numeric literal in a single pass.
+//
+// This handles plain decimal numbers ("42"), C-style hex ("0x2A") and based
+// literals with an optional size and sign ("'h2A", "8'b0010_1010", "6'sd42",
+// "'o52").  Returns a pointer to the character after the literal, or nullptr
+// if the text isn't a number.  Throws if the value doesn't fit in 64 bits, or
+// in the size the literal declares
+//=============================================================================
+static const char* decode_literal(const char* in, uint64_t* p_value)
+{
+    uint64_t value = 0, size = 0;
+    bool     overflow = false, sized = false;
+
+    // Find the start of the literal
+    const char* start = in = skip_whitespace(in);
+    const char* digits;
+
+    // Is this a C-style hex number?
+    if (in[0] == '0' && (in[1] | 0x20) == 'x')
+        in = decode_digits(digits = in + 2, 16, false, &value, &overflow);
+
+    else
+    {
+        // This is either a decimal number, or the size of a based literal
+        in = decode_digits(digits = in, 10, false, &value, &overflow);
+
+        // If there's a tick, it's a based literal
+        const char* p = skip_whitespace(in);
+        if (*p == '\'')
+        {
+            sized = (in != start);
+            size  = value;
+            value = 0;
+
+            // Skip over the optional signed-ness and fetch the radix
+            if ((*++p | 0x20) == 's') ++p;
+            uint32_t radix;
+            switch (*p | 0x20)
+            {
+                case 'b': radix =  2; break;
+                case 'o': radix =  8; break;
+                case 'd': radix = 10; break;
+                case 'h': radix = 16; break;
+                default:  return nullptr;
+            }
+
+            in = decode_digits(digits = skip_whitespace(p + 1), radix, true, &value, &overflow);
+        }
+    }
+
+    // If there were no digits, this isn't a number
+    if (in == digits) return nullptr;
+
+    // Complain if the value doesn't fit
+    if (overflow || (sized && size < 64 && (value >> size)))
+        throw std::runtime_error("numeric literal out of range: " + string(start, in - start));
+
+    *p_value = value;
+    return in;
+}
+//=============================================================================
+
 
 //=============================================================================
-// skip_whitespace() - Skips over whitespace
+// decode_int() - Decodes a Verilog numeric literal.  Anything after the
+//                literal, such as a ';', is ignored, and text that isn't a
+//                number decodes as zero
 //=============================================================================
-static const char* skip_whitespace(const char* p)
+static uint64_t decode_int(const char* in)
 {
-    while (*p == ' ' || *p == 9) ++p;
-    return p;
+    uint64_t value;
+    return decode_literal(in, &value) ? value : 0;
 }
 //=============================================================================
 
 //=============================================================================
-// remaining_text() - Returns a string containing the remaining text in the
-//                    buffer
+// remaining_text() - Returns the remaining text in the buffer, with leading
+//                    and trailing whitespace trimmed off, interned in "arena"
 //=============================================================================
-static string remaining_text(const char* p)
+static istr_t remaining_text(const char* p, CStringArena* arena)
 {   
-    char buffer[8192];
-
     // Skip leading whitespace from the remaining text
     p = skip_whitespace(p);
     
-    // Copy the remaining text into our local buffer
-    strcpy(buffer, p);
-    
-    // Point to the terminating null in the buffer
-    char* lp = strchr(buffer, 0);
+    // Point to the terminating nul
+    const char* lp = strchr(p, 0);
 
-    // Trim trailing whitespace from the buffer
-    while (lp > buffer)
-    {
-        char c = *--lp;
-        if (c == 32 || c == 9)
-            *lp = 0;
-        else
-            break;
-    }
+    // Trim trailing whitespace
+    while (lp > p && (lp[-1] == 32 || lp[-1] == 9)) --lp;
     
-    return buffer;
+    return arena->intern(p, lp - p);
 }
 //=============================================================================
 
 //=============================================================================
 // get_next_token() - Skips over any leading whitespace and returns the
-//                    next token
+//                    next token, interned in "arena"
 //=============================================================================
-static const char* get_next_token(const char* in, string* output)
+static const char* get_next_token(const char* in, istr_t* output, CStringArena* arena)
 {
-    char buffer[5000], *out = buffer;
-
-    // Clear the caller's output field
-    output->clear();
-
     // Skip over any leading whitespace
     in = skip_whitespace(in);
 
-    while (true)
-    {
-        int c = *in;
-        if (c == 32 || c == 9 || c == 0) break;
-        *out++ = *in++;
-    }
-
-    // Nul-terminate the buffer
-    *out = 0;
+    // Find the end of the token
+    const char* token = in;
+    while (*in != 32 && *in != 9 && *in != 0) ++in;
 
     // Fill in the caller's return field
-    *output = buffer;
+    *output = arena->intern(token, in - token);
 
     // Skip over whitespace
     in = skip_whitespace(in);
@@ -211,15 +247,15 @@ static string pos_string(uint32_t pos, uint32_t width)
 // write_register_documentation() - Outputs "//" comments that describe
 //                                  the register
 //=============================================================================
-static void write_register_documentation(FILE* ofile, string register_name)
+static void write_register_documentation(FILE* ofile, const vreg_t& reg)
 {
     int field_count = 0;
 
     fprintf(ofile, "//\n");
-    fprintf(ofile, "// Register:    %s\n", register_name.c_str());
+    fprintf(ofile, "// Register:    %s\n", reg.name.c_str());
 
     // Loop through every entry in the defintion
-    for (auto& e : definition)
+    for (auto& e : reg.definition)
     {
 
         if (e.key == "@register")
@@ -243,8 +279,8 @@ static void write_register_documentation(FILE* ofile, string register_name)
 
         if (e.key == "@field")
         {
-            uint32_t width = decode_int(e.width);
-            uint32_t pos   = decode_int(e.pos);
+            uint32_t width = reg.field[field_count].width;
+            uint32_t pos   = reg.field[field_count].pos;
 
             if (field_count++ == 0)
             {
@@ -275,6 +311,14 @@ static void write_register_documentation(FILE* ofile, string register_name)
             continue;            
         }
 
+        if (e.key == "@enum")
+        {
+            fprintf(ofile, "//                                         ");
+            fprintf(ofile, "                      %s = %s", e.name.c_str(), e.reset.c_str());
+            fprintf(ofile, e.desc.empty() ? "\n" : "  %s\n", e.desc.c_str());
+            continue;
+        }
+
     }
 
     // Leave a blank line at the end to visually offset it
@@ -283,24 +327,143 @@ static void write_register_documentation(FILE* ofile, string register_name)
 //=============================================================================
 
 
+//=============================================================================
+// is_writable() - Returns true if software can write to a field.  This is 
+//                 any type with a "W" in it: RW, WO, W1C, RW1C, W1S, etc.
+//=============================================================================
+bool is_writable(const field_t& field)
+{
+    for (char c : field.type) if (c == 'W' || c == 'w') return true;
+    return false;
+}
+//=============================================================================
+
+
+//=============================================================================
+// is_read_only() - Returns true if a field can be read but not written
+//=============================================================================
+bool is_read_only(const field_t& field)
+{
+    if (field.type.empty()) return false;
+    char c = field.type[0];
+    return (c == 'R' || c == 'r') && !is_writable(field);
+}
+//=============================================================================
+
+
+//=============================================================================
+// field_mask() - Returns a mask of the register bits a field occupies
+//=============================================================================
+uint64_t field_mask(const field_t& field)
+{
+    uint64_t mask = (field.width >= 64) ? ~0ULL : ((1ULL << field.width) - 1);
+    return (field.pos >= 64) ? 0 : mask << field.pos;
+}
+//=============================================================================
+
+
+//=============================================================================
+// reset_value() - Returns the value of a register after reset
+//=============================================================================
+uint64_t reset_value(const vreg_t& reg)
+{
+    uint64_t result = 0;
+
+    for (auto& f : reg.field)
+    {
+        if (f.pos < 64) result |= (f.reset << f.pos) & field_mask(f);
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_mask() - Returns a mask of the register bits that are writable
+//=============================================================================
+uint64_t write_mask(const vreg_t& reg)
+{
+    uint64_t result = 0;
+    for (auto& f : reg.field) if (is_writable(f)) result |= field_mask(f);
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// read_only_mask() - Returns a mask of the register bits that are read-only
+//=============================================================================
+uint64_t read_only_mask(const vreg_t& reg)
+{
+    uint64_t result = 0;
+    for (auto& f : reg.field) if (is_read_only(f)) result |= field_mask(f);
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// rmw_zero_mask() - Returns the register bits that a read-modify-write must
+//                   write as zero.  These are the fields where writing back
+//                   the value that was read would have a side effect, which
+//                   is any writable type with a "1" in it (W1C, W1S, RW1C...)
+//=============================================================================
+uint64_t rmw_zero_mask(const vreg_t& reg)
+{
+    uint64_t result = 0;
+
+    for (auto& f : reg.field)
+    {
+        if (is_writable(f) && f.type.find('1') != string::npos) result |= field_mask(f);
+    }
+
+    return result;
+}
+//=============================================================================
+
+
 //=============================================================================
 // write_c_constants() - Output the #define statements that C/C++ require
+//
+// If "base_macro" is empty, "reg_addr" is an absolute AXI address.  Otherwise
+// "reg_addr" is an offset, and every constant is emitted relative to the 
+// named base-address macro
 //=============================================================================
-static void write_c_constants(FILE* ofile, string reg_name, uint32_t reg_addr)
+static void write_c_constants(FILE* ofile, const vreg_t& reg, uint32_t reg_addr,
+                              string base_macro, bool with_masks)
 {
-    fprintf(ofile, "#define %-60s 0x%016xULL\n", reg_name.c_str(), reg_addr);
+    const istr_t& reg_name = reg.name;
+    char          field[1024];
 
-    // Loop through every entry in the defintion
-    for (auto& e : definition)
+    // Are we emitting constants that are relative to a base-address macro?
+    bool relative = !base_macro.empty();
+
+    if (relative)
+        fprintf(ofile, "#define %-60s (%s + 0x%016xULL)\n", reg_name.c_str(), base_macro.c_str(), reg_addr);
+    else
+        fprintf(ofile, "#define %-60s 0x%016xULL\n", reg_name.c_str(), reg_addr);
+
+    // Loop through every field in the register
+    for (auto& e : reg.field)
     {
-        if (e.key == "@field")
-        {
-            uint32_t width = decode_int(e.width);
-            uint32_t pos   = decode_int(e.pos);
-            uint32_t spec  = (width << 24) | (pos << 16);
-            string   field = reg_name + "_" + e.name;
-            fprintf(ofile, "#define %-60s 0x%08x%08xULL\n", field.c_str(), spec, reg_addr);
-        }
+        uint32_t spec  = (e.width << 24) | (e.pos << 16);
+        snprintf(field, sizeof field, "%s_%s", reg_name.c_str(), e.name.c_str());
+        if (relative)
+            fprintf(ofile, "#define %-60s (%s + 0x%08x%08xULL)\n", field, base_macro.c_str(), spec, reg_addr);
+        else
+            fprintf(ofile, "#define %-60s 0x%08x%08xULL\n", field, spec, reg_addr);
+    }
+
+    // If the caller wants them, output the composite reset value and masks
+    if (with_masks)
+    {
+        string name = reg_name + "_RESET_VALUE";
+        fprintf(ofile, "#define %-60s 0x%016lxULL\n", name.c_str(), reset_value(reg));
+        name = reg_name + "_WRITE_MASK";
+        fprintf(ofile, "#define %-60s 0x%016lxULL\n", name.c_str(), write_mask(reg));
+        name = reg_name + "_RO_MASK";
+        fprintf(ofile, "#define %-60s 0x%016lxULL\n", name.c_str(), read_only_mask(reg));
     }
 
     // Leave a couple of blank lines after every set of constants
@@ -343,7 +506,7 @@ static string parse_localparam_name(const char* in)
 //=============================================================================
 // parse_localparam_value() - Fetches the value of the localparam constant
 //=============================================================================
-static uint32_t parse_localparam_value(const char* in)
+static uint64_t parse_localparam_value(const char* in)
 {
     // Find the '=' character
     in = strchr(in, '=');
@@ -383,104 +546,406 @@ static string make_reg_name(string lparam, string prefix)
 //=============================================================================
 
 //=============================================================================
-// parse_verilog_regs() - Reads in a Verilog file containing register
-//                        definitions and outputs the corresponding C/C++
-//                        header file.
+// CVerilogParser() - Constructor.  Every string in the registers we parse is
+//                    interned in "arena".  If "diag" is nullptr, the first
+//                    problem we find throws
 //=============================================================================
-void parse_verilog_regs(FILE* ifile, uint32_t base_addr, string prefix, FILE* ofile)
+CVerilogParser::CVerilogParser(const string& prefix, CStringArena* arena,
+                               const string& filename, CDiagnostics* diag)
 {
-    entry_t entry;
-    char    buffer[1000];
-    int     register_index = -1;
-    string  alternate_rname;
+    m_prefix         = prefix;
+    m_arena          = arena;
+    m_filename       = filename;
+    m_diag           = diag;
+    m_line           = 0;
+    m_register_index = -1;
+}
+//=============================================================================
 
-    // Loop through each line of the input
-    while (fgets(buffer, sizeof buffer, ifile))
+
+//=============================================================================
+// error() - Reports a problem at a column of the line being parsed
+//=============================================================================
+void CVerilogParser::error(uint32_t column, const string& message)
+{
+    if (m_diag)
+        m_diag->error(m_filename, m_line, column, message);
+    else
+        throw std::runtime_error(format_diagnostic({m_filename, m_line, column, message}));
+}
+//=============================================================================
+
+
+//=============================================================================
+// decode_token() - Decodes a token that must be nothing but a number.  If it
+//                  isn't, that's reported at "column" and *p_value is zero
+//=============================================================================
+bool CVerilogParser::decode_token(const char* line, const char* column, const istr_t& token,
+                                  const char* what, uint64_t* p_value)
+{
+    try
     {
-        // Remove the CR or LF from the end of the line
-        chomp(buffer);
+        const char* end = decode_literal(token.c_str(), p_value);
+        if (end && *end == 0) return true;
+        error(column - line + 1, "bad " + string(what) + " '" + token.str() + "'");
+    }
+    catch (const std::runtime_error& e)
+    {
+        if (m_diag == nullptr) throw;
+        error(column - line + 1, e.what());
+    }
 
-        // Skip past any leading whitespace
-        const char* in = skip_whitespace(buffer);
+    *p_value = 0;
+    return false;
+}
+//=============================================================================
 
-        // Skip any line that is blank, a comment, /* or */
-        if (*in == 0)                     continue;
-        if (in[0] == '/' && in[1] == '/') continue;
-        if (in[0] == '/' && in[1] == '*') continue;
-        if (in[0] == '*' && in[1] == '/') continue;
 
-        // Make sure all the fields of our entry are empty
-        entry.clear();
+//=============================================================================
+// parse_field() - Splits an "@field" line into its columns and decodes them.
+//                 "in" points just past the "@field" key.  A column that
+//                 doesn't decode is reported, and decodes as zero
+//=============================================================================
+void CVerilogParser::parse_field(const char* line, const char* in, entry_t* p_entry)
+{
+    const char* column[5];
+    istr_t*     token[5] = {&p_entry->name, &p_entry->width, &p_entry->pos,
+                            &p_entry->type, &p_entry->reset};
 
-        // Fetch the first token on the line
-        in = get_next_token(in, &entry.key);
-        
-        // Are we defining a new register?
-        if (entry.key == "@register")
-        {
-            alternate_rname.clear();
-            definition.clear();
-            entry.desc = remaining_text(in);
-            definition.push_back(entry);
-            register_index = definition.size() - 1;
-            continue;
-        }
+    // Split the line into its columns, remembering where each one starts
+    for (int i = 0; i < 5; ++i)
+    {
+        column[i] = skip_whitespace(in);
+        in = get_next_token(in, token[i], m_arena);
+    }
+    p_entry->desc = remaining_text(in, m_arena);
 
-        // Are we capturing an alternate register name?
-        if (entry.key == "@rname")
-        {
-            alternate_rname = remaining_text(in);
-            continue;
-        }
+    field_t  field = {p_entry->name, 0, 0, p_entry->type, 0};
+    uint64_t width, pos, reset = 0;
 
-        // Are we modifying the previous "@register" by altering the width?
-        if (entry.key == "@rsize" && register_index >= 0)
-        {
-            definition[register_index].width = remaining_text(in);
-            continue;
-        }
+    // Every column but the reset value is required.  Once one is missing, so
+    // are all the ones after it, so only the first gets reported
+    static const char* name[] = {"name", "width", "position", "type"};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!token[i]->empty()) continue;
+        error(column[i] - line + 1, "missing field " + string(name[i]));
+        m_field.push_back(field);
+        m_field_line.push_back(m_line);
+        return;
+    }
+
+    if (decode_token(line, column[1], *token[1], "field width", &width) && (width == 0 || width > 64))
+    {
+        error(column[1] - line + 1, "field width " + std::to_string(width) + " is out of range");
+        width = 0;
+    }
+
+    if (decode_token(line, column[2], *token[2], "field position", &pos) && pos >= 64)
+    {
+        error(column[2] - line + 1, "field position " + std::to_string(pos) + " is out of range");
+        pos = 0;
+    }
+
+    // A field with no description may leave the reset value out
+    if (!token[4]->empty() && decode_token(line, column[4], *token[4], "reset value", &reset)
+     && width && width < 64 && (reset >> width))
+    {
+        error(column[4] - line + 1, "reset value doesn't fit in a " + std::to_string(width) + "-bit field");
+    }
+
+    field.width = width;
+    field.pos   = pos;
+    field.reset = reset;
+    m_field.push_back(field);
+    m_field_line.push_back(m_line);
+}
+//=============================================================================
+
+
+//=============================================================================
+// parse_enum() - Decodes an "@enum NAME VALUE description" line, which names
+//                one of the values of the preceding "@field".  "in" points
+//                just past the "@enum" key
+//=============================================================================
+void CVerilogParser::parse_enum(const char* line, const char* in, entry_t* p_entry)
+{
+    uint64_t value;
+
+    // The columns are the name, the value and the description
+    const char* name_column = skip_whitespace(in);
+    in = get_next_token(in, &p_entry->name, m_arena);
+    const char* value_column = skip_whitespace(in);
+    in = get_next_token(in, &p_entry->reset, m_arena);
+    p_entry->desc = remaining_text(in, m_arena);
+
+    uint32_t      name_col  = name_column  - line + 1;
+    uint32_t      value_col = value_column - line + 1;
+    const istr_t& name      = p_entry->name;
+
+    // The values being named belong to the most recent field
+    if (m_field.empty())
+    {
+        error(name_col, "@enum must follow an @field");
+        return;
+    }
+    field_t& field = m_field.back();
+
+    // The name has to be usable as a C identifier
+    bool ident = !name.empty() && !isdigit((uint8_t)name[0]);
+    for (char c : name) if (!isalnum((uint8_t)c) && c != '_') ident = false;
+    if (!ident)
+    {
+        error(name_col, name.empty() ? "missing enum name" : "bad enum name '" + name.str() + "'");
+        return;
+    }
+
+    // The value has to be a number that fits in the field
+    if (p_entry->reset.empty())
+    {
+        error(value_col, "missing enum value");
+        return;
+    }
+    if (!decode_token(line, value_column, p_entry->reset, "enum value", &value)) return;
+    if (field.width < 64 && (value >> field.width))
+    {
+        error(value_col, "enum value doesn't fit in the " + std::to_string(field.width)
+                       + "-bit field " + field.name.str());
+        return;
+    }
 
-        // Are we adding a comment line to a register or field description?
-        if (entry.key == "@fdesc" || entry.key == "@rdesc")
+    // Every name, and every value, can only be used once per field
+    for (auto& e : field.enums)
+    {
+        if (e.name == name)
         {
-            entry.desc = remaining_text(in);
-            definition.push_back(entry);
-            continue;
+            error(name_col, "duplicate enum name " + name.str());
+            return;
         }
-
-        // Was this a "@field" definition?
-        if (entry.key == "@field")
+        if (e.value == value)
         {
-            in = get_next_token(in, &entry.name);
-            in = get_next_token(in, &entry.width);
-            in = get_next_token(in, &entry.pos);
-            in = get_next_token(in, &entry.type);
-            in = get_next_token(in, &entry.reset);
-            entry.desc = remaining_text(in);
-            definition.push_back(entry);
-            continue;
+            error(value_col, "enum value is already named " + e.name.str());
+            return;
         }
+    }
 
+    field.enums.push_back({name, value, p_entry->desc});
+}
+//=============================================================================
 
-        // Is it time to output some documentation and definitions?
-        if (entry.key == "localparam" && definition.size())
-        {
-            string   lparam_name  = parse_localparam_name(in);
-            uint32_t lparam_value = parse_localparam_value(in);
-            if (alternate_rname != "") lparam_name = alternate_rname;
-            string   reg_name = make_reg_name(lparam_name, prefix);
-            uint32_t reg_addr = base_addr + (lparam_value * 4);
- 
-            if (!reg_name.empty())
-            {
-                write_register_documentation(ofile, reg_name);
-                write_c_constants(ofile, reg_name, reg_addr);
-                definition.clear();
-            }
-        }
 
+//=============================================================================
+// parse_line() - Parses one line of Verilog, which has no line ending.
+//
+// Returns true if the line is the "localparam" that completes a register, in
+// which case the register is returned in *p_reg
+//=============================================================================
+bool CVerilogParser::parse_line(const char* line, vreg_t* p_reg)
+{
+    entry_t entry;
+
+    // Keep track of where we are, for reporting problems
+    ++m_line;
+
+    // Skip past any leading whitespace
+    const char* in = skip_whitespace(line);
+
+    // Skip any line that is blank, a comment, /* or */
+    if (*in == 0)                     return false;
+    if (in[0] == '/' && in[1] == '/') return false;
+    if (in[0] == '/' && in[1] == '*') return false;
+    if (in[0] == '*' && in[1] == '/') return false;
+
+    // Fetch the first token on the line
+    in = get_next_token(in, &entry.key, m_arena);
+    
+    // Are we defining a new register?
+    if (entry.key == "@register")
+    {
+        m_alternate_rname = istr_t();
+        m_definition.clear();
+        m_field.clear();
+        m_field_line.clear();
+        entry.desc = remaining_text(in, m_arena);
+        m_definition.push_back(entry);
+        m_register_index = m_definition.size() - 1;
+        return false;
+    }
+
+    // Are we capturing an alternate register name?
+    if (entry.key == "@rname")
+    {
+        m_alternate_rname = remaining_text(in, m_arena);
+        return false;
+    }
+
+    // Are we modifying the previous "@register" by altering the width?
+    if (entry.key == "@rsize" && m_register_index >= 0)
+    {
+        m_definition[m_register_index].width = remaining_text(in, m_arena);
+        return false;
+    }
+
+    // Are we adding a comment line to a register or field description?
+    if (entry.key == "@fdesc" || entry.key == "@rdesc")
+    {
+        entry.desc = remaining_text(in, m_arena);
+        m_definition.push_back(entry);
+        return false;
+    }
+
+    // Was this a "@field" definition?
+    if (entry.key == "@field")
+    {
+        parse_field(line, in, &entry);
+        m_definition.push_back(entry);
+        return false;
+    }
+
+    // Are we naming one of the values of the previous "@field"?
+    if (entry.key == "@enum")
+    {
+        parse_enum(line, in, &entry);
+        m_definition.push_back(entry);
+        return false;
+    }
+
+    // If this isn't the localparam that ends a definition, we're done
+    if (entry.key != "localparam" || m_definition.empty()) return false;
+
+    // Find out what the register is called
+    string lparam_name = parse_localparam_name(in);
+    if (!m_alternate_rname.empty()) lparam_name = m_alternate_rname.str();
+    string reg_name = make_reg_name(lparam_name, m_prefix);
+
+    // If the localparam isn't a register, it doesn't complete anything
+    if (reg_name.empty()) return false;
+
+    // Find out where the register lives
+    uint64_t lparam_value = 0;
+    const char* equal = strchr(in, '=');
+    try
+    {
+        lparam_value = parse_localparam_value(in);
+    }
+    catch (const std::runtime_error& e)
+    {
+        if (m_diag == nullptr) throw;
+        error(equal - line + 2, e.what());
+    }
+
+    // The byte offset of the register has to fit in 32 bits
+    if (lparam_value > UINT32_MAX / 4)
+    {
+        char text[100];
+        snprintf(text, sizeof text, "register index 0x%lx is out of range", lparam_value);
+        error(equal - line + 2, text);
+        lparam_value = 0;
+    }
+
+    // Build the register from the definitions
+    istr_t rsize      = m_definition[0].width;
+    p_reg->name       = m_arena->intern(reg_name);
+    p_reg->short_name = m_arena->intern(make_reg_name(lparam_name, ""));
+    p_reg->offset     = lparam_value * 4;
+    p_reg->size       = (rsize == "64") ? 64 : 32;
+
+    // Every field has to fit in the register
+    for (size_t i = 0; i < m_field.size(); ++i)
+    {
+        const field_t& f = m_field[i];
+        if (f.pos + f.width <= p_reg->size) continue;
+        string message = "field " + f.name.str() + " doesn't fit in the "
+                       + std::to_string(p_reg->size) + "-bit register " + reg_name;
+        if (m_diag)
+            m_diag->error(m_filename, m_field_line[i], 0, message);
+        else
+            throw std::runtime_error(format_diagnostic({m_filename, m_field_line[i], 0, message}));
+    }
+
+    p_reg->field.swap(m_field);
+    p_reg->definition.swap(m_definition);
+    m_definition.clear();
+    m_field.clear();
+    m_field_line.clear();
+    return true;
+}
+//=============================================================================
+
+
+//=============================================================================
+// parse_verilog_regs() - Reads in a Verilog file containing register
+//                        definitions and appends a vreg_t to "p_regs" for
+//                        every register it defines
+//=============================================================================
+void parse_verilog_regs(FILE* ifile, string prefix, vector<vreg_t>* p_regs,
+                        CStringArena* arena, const string& filename, CDiagnostics* diag)
+{
+    CVerilogParser parser(prefix, arena, filename, diag);
+    vreg_t         reg;
+    char           buffer[1000];
+
+    // Loop through each line of the input
+    while (fgets(buffer, sizeof buffer, ifile))
+    {
+        // Remove the CR or LF from the end of the line
+        chomp(buffer);
+
+        // Parse the line, and keep the register if it completes one
+        if (parser.parse_line(buffer, &reg)) p_regs->push_back(reg);
     }
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_register_define() - Outputs the documentation and #define statements
+//                           for a single register
+//
+// If "base_macro" is not empty, register and field constants are emitted as
+// offsets from that macro rather than as absolute addresses.
+//
+// If "with_masks" is true, the register also gets its composite reset value,
+// a mask of its writable bits and a mask of its read-only bits
+//=============================================================================
+void write_register_define(FILE* ofile, const vreg_t& reg, uint32_t base_addr,
+                           const string& base_macro, bool with_masks)
+{
+    uint32_t reg_addr = reg.offset;
+    if (base_macro.empty()) reg_addr += base_addr;
+    write_register_documentation(ofile, reg);
+    write_c_constants(ofile, reg, reg_addr, base_macro, with_masks);
+}
+//=============================================================================
 
+
+//=============================================================================
+// write_register_defines() - Outputs the documentation and #define statements
+//                            for every register in the list
+//=============================================================================
+void write_register_defines(FILE* ofile, const vector<vreg_t>& regs, uint32_t base_addr,
+                            string base_macro, bool with_masks)
+{
+    for (auto& reg : regs) write_register_define(ofile, reg, base_addr, base_macro, with_masks);
 }
 //=============================================================================
 
+
+//=============================================================================
+// sort_by_offset() - Returns pointers to the registers in "regs", sorted in
+//                    order of ascending offset
+//=============================================================================
+vector<const vreg_t*> sort_by_offset(const vector<vreg_t>& regs)
+{
+    vector<const vreg_t*> result;
+
+    for (auto& reg : regs) result.push_back(&reg);
+
+    std::stable_sort(result.begin(), result.end(), [](const vreg_t* a, const vreg_t* b)
+    {
+        return a->offset < b->offset;
+    });
+
+    return result;
+}
+//=============================================================================
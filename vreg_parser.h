@@ -3,4 +3,157 @@
 #include <cstdlib>
 #include <cstdint>
 #include <string>
-void parse_verilog_regs(FILE* ifile, uint32_t base_addr, std::string prefix, FILE* ofile = stdout);
\ No newline at end of file
+#include <vector>
+#include "vreg_arena.h"
+#include "vreg_diag.h"
+
+// We will keep a vector of various kinds of definitions.
+// Each entry in the vector is one of these.  The text lives in the
+// CStringArena of the parse that produced it
+struct entry_t
+{
+    istr_t  key;
+    istr_t  name;
+    istr_t  width;
+    istr_t  pos;
+    istr_t  type;
+    istr_t  reset;
+    istr_t  desc;
+    void clear() {*this = entry_t();}
+};
+
+// A named value of a field, from an "@enum" line
+struct enum_value_t
+{
+    istr_t      name;
+    uint64_t    value;
+    istr_t      desc;
+};
+
+// A decoded "@field" definition
+struct field_t
+{
+    istr_t      name;
+    uint32_t    width;
+    uint32_t    pos;
+    istr_t      type;
+    uint64_t    reset;
+
+    // The named values of the field, in the order they were defined
+    std::vector<enum_value_t> enums;
+};
+
+// A register parsed from a Verilog source file
+struct vreg_t
+{
+    // Register name, with the connection prefix
+    istr_t               name;
+
+    // Register name, without the connection prefix
+    istr_t               short_name;
+
+    // Byte offset of the register from the connection's base address
+    uint32_t             offset;
+
+    // Register size in bits (32 or 64)
+    uint32_t             size;
+
+    // The "@" lines that define this register, in the order they were parsed
+    std::vector<entry_t> definition;
+
+    // The decoded "@field" lines
+    std::vector<field_t> field;
+};
+
+// Field type classification, from the TYPE column of an "@field" line
+bool is_writable(const field_t& field);
+bool is_read_only(const field_t& field);
+
+// Returns the mask of register bits that a field occupies
+uint64_t field_mask(const field_t& field);
+
+// Composite per-register values, built from the "@field" lines
+uint64_t reset_value(const vreg_t& reg);
+uint64_t write_mask(const vreg_t& reg);
+uint64_t read_only_mask(const vreg_t& reg);
+uint64_t rmw_zero_mask(const vreg_t& reg);
+
+//-----------------------------------------------------------------------------
+// CVerilogParser - Parses register definitions one line at a time, so that
+//                  the lines can come from a file or from a buffer in memory
+//-----------------------------------------------------------------------------
+class CVerilogParser
+{
+public:
+
+    // Register names get "prefix", and every string is interned in "arena".
+    // Problems are reported against "filename".  If "diag" is given, they're
+    // recorded there and parsing carries on, otherwise the first one throws
+    CVerilogParser(const std::string& prefix, CStringArena* arena,
+                   const std::string& filename = "", CDiagnostics* diag = nullptr);
+
+    // Parses a line with no line ending.  Lines must be handed over in order.
+    // Returns true if the line completes a register, which is returned in *p_reg
+    bool parse_line(const char* line, vreg_t* p_reg);
+
+protected:
+
+    // Reports a problem at a column of the current line
+    void error(uint32_t column, const std::string& message);
+
+    // Decodes the "@field" line that starts at "line"
+    void parse_field(const char* line, const char* in, entry_t* p_entry);
+
+    // Decodes an "@enum" line, which names a value of the preceding "@field"
+    void parse_enum(const char* line, const char* in, entry_t* p_entry);
+
+    // Decodes a token that must be nothing but a number.  "column" is where
+    // the token starts in "line".  Returns false if it isn't a number
+    bool decode_token(const char* line, const char* column, const istr_t& token,
+                      const char* what, uint64_t* p_value);
+
+    // Where problems get reported
+    std::string          m_filename;
+    CDiagnostics*        m_diag;
+
+    // The number of the line being parsed
+    uint32_t             m_line;
+
+    // The connection prefix of register names
+    std::string          m_prefix;
+
+    // Where the strings we parse are interned
+    CStringArena*        m_arena;
+
+    // The definition lines of the register currently being parsed
+    std::vector<entry_t> m_definition;
+
+    // Where the "@register" line is in m_definition
+    int                  m_register_index;
+
+    // The name from an "@rname" line, if there was one
+    istr_t               m_alternate_rname;
+
+    // The decoded "@field" lines of the register, and the line of each
+    std::vector<field_t>  m_field;
+    std::vector<uint32_t> m_field_line;
+};
+//-----------------------------------------------------------------------------
+
+// Parses a Verilog file and appends the registers it defines to "p_regs".  Every
+// string in those registers is interned in "arena", which must outlive them.
+// Problems are handled as they are by CVerilogParser
+void parse_verilog_regs(FILE* ifile, std::string prefix, std::vector<vreg_t>* p_regs,
+                        CStringArena* arena, const std::string& filename = "",
+                        CDiagnostics* diag = nullptr);
+
+// Writes documentation and #define statements for one register
+void write_register_define(FILE* ofile, const vreg_t& reg, uint32_t base_addr,
+                           const std::string& base_macro, bool with_masks);
+
+// Writes documentation and #define statements for a list of registers
+void write_register_defines(FILE* ofile, const std::vector<vreg_t>& regs, uint32_t base_addr,
+                            std::string base_macro = "", bool with_masks = false);
+
+// Returns pointers to the registers in a list, sorted by offset
+std::vector<const vreg_t*> sort_by_offset(const std::vector<vreg_t>& regs);
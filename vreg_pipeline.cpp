@@ -0,0 +1,353 @@
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include "vreg_pipeline.h"
+
+using std::vector;
+using std::string;
+using std::shared_ptr;
+
+// The reader hands the parser chunks of about this many bytes
+static const size_t CHUNK_SIZE = 16 * 1024;
+
+// A run of complete lines from a register file, or the end of a file
+struct chunk_t
+{
+    uint32_t          job;
+    shared_ptr<string> text;
+    size_t            begin, end;
+    bool              last;
+    string            error;
+};
+
+// A parsed register, or the end of a file
+struct parsed_t
+{
+    uint32_t job;
+    bool     has_reg;
+    vreg_t   reg;
+    bool     last;
+    string   error;
+};
+
+// The queues between the stages
+typedef CSpscQueue<chunk_t,   16> chunk_queue_t;
+typedef CSpscQueue<parsed_t, 256> parsed_queue_t;
+
+
+//=============================================================================
+// parse_lines() - Parses the lines from "p" up to "end" in place, and calls
+//                 "found" with each register as soon as it's complete.
+//                 Returns false, without parsing the rest, if "found" does
+//=============================================================================
+template <typename F>
+static bool parse_lines(char* p, char* end, CVerilogParser& parser, vreg_t& reg, F found)
+{
+    while (p < end)
+    {
+        char* eol  = (char*)memchr(p, '\n', end - p);
+        char* next = eol ? eol + 1 : end;
+        if (eol == nullptr) eol = end;
+        if (eol > p && eol[-1] == '\r') --eol;
+        *eol = 0;
+
+        if (parser.parse_line(p, &reg) && !found()) return false;
+
+        p = next;
+    }
+
+    return true;
+}
+//=============================================================================
+
+
+//=============================================================================
+// read_stage() - Fetches the file of every job and cuts it into chunks of
+//                complete lines for the parser
+//=============================================================================
+static void read_stage(vector<pipeline_job_t>& jobs, CFilePrefetcher& prefetcher,
+                       chunk_queue_t& out, const std::atomic<bool>& abort, double* p_busy,
+                       CDiagnostics* diag)
+{
+    double start = monotonic_ms();
+
+    for (uint32_t i = 0; i < jobs.size(); ++i)
+    {
+        pipeline_job_t& job = jobs[i];
+
+        // A cached job has nothing to read, but the parser still needs to know about it
+        if (job.cached)
+        {
+            if (!out.push({i, nullptr, 0, 0, true, ""}, abort)) break;
+            continue;
+        }
+
+        // Fetch the file, most likely already read by the prefetcher
+        prefetched_file_t file;
+        prefetcher.fetch(job.conn->filename, &file);
+        if (!file.ok && diag)
+        {
+            diag->error(job.conn->filename, 0, 0, "can't open file");
+            if (!out.push({i, nullptr, 0, 0, true, ""}, abort)) break;
+            continue;
+        }
+        if (!file.ok)
+        {
+            out.push({i, nullptr, 0, 0, true, "can't open " + job.conn->filename}, abort);
+            break;
+        }
+        job.stamped = file.stamped;
+        job.stamp   = file.stamp;
+
+        // Cut the file into chunks that end on a line boundary
+        auto   text = std::make_shared<string>(std::move(file.contents));
+        size_t size = text->size(), begin = 0;
+        while (begin < size)
+        {
+            size_t end = begin + CHUNK_SIZE;
+            if (end >= size)
+                end = size;
+            else
+            {
+                const char* nl = (const char*)memchr(text->data() + end, '\n', size - end);
+                end = nl ? nl - text->data() + 1 : size;
+            }
+            if (!out.push({i, text, begin, end, false, ""}, abort)) break;
+            begin = end;
+        }
+
+        // And mark the end of the file
+        if (!out.push({i, nullptr, 0, 0, true, ""}, abort)) break;
+    }
+
+    *p_busy = monotonic_ms() - start - out.stats().full_wait_ms;
+}
+//=============================================================================
+
+
+//=============================================================================
+// parse_stage() - Parses chunks of lines and hands every register to the
+//                 renderer as soon as it's complete
+//=============================================================================
+static void parse_stage(vector<pipeline_job_t>& jobs, chunk_queue_t& in, parsed_queue_t& out,
+                        const std::atomic<bool>& abort, double* p_busy, CDiagnostics* diag)
+{
+    double                          start = monotonic_ms();
+    std::unique_ptr<CVerilogParser> parser;
+    chunk_t                         chunk;
+    parsed_t                        parsed;
+    uint32_t                        done = 0;
+
+    while (done < jobs.size() && in.pop(&chunk, abort))
+    {
+        // If the reader failed, pass the error along and quit
+        if (!chunk.error.empty())
+        {
+            out.push({chunk.job, false, vreg_t(), true, chunk.error}, abort);
+            break;
+        }
+
+        // At the end of a file, tell the renderer that file is complete
+        if (chunk.last)
+        {
+            parser.reset();
+            ++done;
+            if (!out.push({chunk.job, false, vreg_t(), true, ""}, abort)) break;
+            continue;
+        }
+
+        // The first chunk of a file gets a new parser, and a new arena for its strings
+        connection_t* conn = jobs[chunk.job].conn;
+        if (!parser)
+        {
+            auto arena = std::make_shared<CStringArena>();
+            parser.reset(new CVerilogParser(conn->prefix, arena.get(), conn->filename, diag));
+            conn->strings = arena;
+        }
+
+        // Parse every line of the chunk in place
+        char* p   = &(*chunk.text)[chunk.begin];
+        char* end = &(*chunk.text)[0] + chunk.end;
+        try
+        {
+            bool ok = parse_lines(p, end, *parser, parsed.reg, [&]()
+            {
+                parsed.job     = chunk.job;
+                parsed.has_reg = true;
+                parsed.last    = false;
+                return out.push(std::move(parsed), abort);
+            });
+            if (!ok) break;
+        }
+        catch (const std::exception& e)
+        {
+            out.push({chunk.job, false, vreg_t(), true, e.what()}, abort);
+            break;
+        }
+    }
+
+    *p_busy = monotonic_ms() - start - in.stats().empty_wait_ms - out.stats().full_wait_ms;
+}
+//=============================================================================
+
+
+//=============================================================================
+// run_inline() - Runs every stage on the caller's thread, one job at a time.
+//                With a single CPU, stage threads could only take turns, so
+//                all they would add is the cost of handing work between them
+//=============================================================================
+static void run_inline(vector<pipeline_job_t>& jobs, CFilePrefetcher& prefetcher,
+                       const pipeline_renderer_t& renderer, CDiagnostics* diag)
+{
+    vreg_t reg;
+
+    for (auto& job : jobs)
+    {
+        connection_t& conn = *job.conn;
+
+        renderer.begin(job);
+
+        // Cached registers need no reading or parsing
+        if (job.cached)
+        {
+            for (auto& r : conn.regs) renderer.reg(job, r);
+            renderer.end(job);
+            continue;
+        }
+
+        // Fetch the file, most likely already read by the prefetcher
+        prefetched_file_t file;
+        prefetcher.fetch(conn.filename, &file);
+        if (!file.ok && diag)
+        {
+            diag->error(conn.filename, 0, 0, "can't open file");
+            renderer.end(job);
+            continue;
+        }
+        if (!file.ok) throw std::runtime_error("can't open " + conn.filename);
+        job.stamped = file.stamped;
+        job.stamp   = file.stamp;
+
+        // Parse the file a line at a time, rendering registers as we go
+        auto           arena = std::make_shared<CStringArena>();
+        CVerilogParser parser(conn.prefix, arena.get(), conn.filename, diag);
+        conn.strings = arena;
+        char* p = &file.contents[0];
+        parse_lines(p, p + file.contents.size(), parser, reg, [&]()
+        {
+            conn.regs.push_back(std::move(reg));
+            renderer.reg(job, conn.regs.back());
+            return true;
+        });
+
+        renderer.end(job);
+    }
+}
+//=============================================================================
+
+
+//=============================================================================
+// run_pipeline() - Reads, parses and renders the register files of a list of
+//                  connections.
+//
+// The reader and the parser each have a thread of their own, and rendering is
+// done on the caller's thread.  The stages are connected by bounded queues, so
+// even a single huge file has its I/O, parsing and rendering overlapped, and
+// no stage can get more than a queue's length ahead of the next one
+//=============================================================================
+void run_pipeline(vector<pipeline_job_t>& jobs, CFilePrefetcher& prefetcher,
+                  const pipeline_renderer_t& renderer, pipeline_stats_t* p_stats,
+                  CDiagnostics* diag)
+{
+    std::atomic<bool>               abort(false);
+    std::unique_ptr<chunk_queue_t>  chunks(new chunk_queue_t);
+    std::unique_ptr<parsed_queue_t> regs(new parsed_queue_t);
+    double                          start = monotonic_ms();
+    double                          read_busy = 0, parse_busy = 0;
+    parsed_t                        parsed;
+    uint32_t                        done = 0, current = jobs.size();
+    string                          error;
+
+    // If there's nothing to do, don't bother starting threads
+    if (jobs.empty()) return;
+
+    // With a single CPU, there's nothing for the stages to overlap with
+    if (std::thread::hardware_concurrency() < 2)
+    {
+        run_inline(jobs, prefetcher, renderer, diag);
+        if (p_stats) p_stats->ran = true;
+        return;
+    }
+
+    // Start the reader and the parser
+    std::thread reader(read_stage, std::ref(jobs), std::ref(prefetcher), std::ref(*chunks),
+                       std::cref(abort), &read_busy, diag);
+    std::thread parser(parse_stage, std::ref(jobs), std::ref(*chunks), std::ref(*regs),
+                       std::cref(abort), &parse_busy, diag);
+
+    // Render registers as they arrive
+    try
+    {
+        while (done < jobs.size() && regs->pop(&parsed, abort))
+        {
+            // Did an earlier stage fail?
+            if (!parsed.error.empty())
+            {
+                error = parsed.error;
+                break;
+            }
+
+            pipeline_job_t& job  = jobs[parsed.job];
+            connection_t&   conn = *job.conn;
+
+            // Is this the start of a new job?
+            if (parsed.job != current)
+            {
+                current = parsed.job;
+                renderer.begin(job);
+            }
+
+            // Render each register as it arrives
+            if (parsed.has_reg)
+            {
+                conn.regs.push_back(std::move(parsed.reg));
+                renderer.reg(job, conn.regs.back());
+            }
+
+            // At the end of a job, cached registers get rendered all at once
+            if (parsed.last)
+            {
+                if (job.cached) for (auto& reg : conn.regs) renderer.reg(job, reg);
+                renderer.end(job);
+                ++done;
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        error = e.what();
+    }
+
+    // Stop the other stages and wait for them
+    abort = !error.empty();
+    reader.join();
+    parser.join();
+
+    if (!error.empty()) throw std::runtime_error(error);
+
+    // Tell the caller where the time went
+    if (p_stats)
+    {
+        p_stats->ran            = true;
+        p_stats->threaded       = true;
+        p_stats->total_ms       = monotonic_ms() - start;
+        p_stats->read_ms        = read_busy;
+        p_stats->parse_ms       = parse_busy;
+        p_stats->render_ms      = p_stats->total_ms - regs->stats().empty_wait_ms;
+        p_stats->chunks         = chunks->stats();
+        p_stats->regs           = regs->stats();
+        p_stats->chunk_capacity = chunks->capacity();
+        p_stats->reg_capacity   = regs->capacity();
+    }
+}
+//=============================================================================
@@ -0,0 +1,154 @@
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include "amap_parser.h"
+#include "vreg_prefetch.h"
+
+// Returns a monotonic timestamp in milliseconds
+inline double monotonic_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// What a queue saw while the pipeline ran
+struct queue_stats_t
+{
+    uint64_t pushes;         // Items that went through the queue
+    uint64_t depth_sum;      // Sum of the queue depth that each push left behind
+    uint64_t full_waits;     // Pushes that had to wait for room
+    uint64_t empty_waits;    // Pops that had to wait for an item
+    double   full_wait_ms;   // Time the producer spent waiting for room
+    double   empty_wait_ms;  // Time the consumer spent waiting for an item
+};
+
+//-----------------------------------------------------------------------------
+// CSpscQueue - A bounded, lock-free queue between exactly one producer
+//              thread and exactly one consumer thread.  A side that has to
+//              wait gives up its CPU, and gives up altogether if "abort" is set
+//-----------------------------------------------------------------------------
+template <typename T, size_t N> class CSpscQueue
+{
+public:
+
+    CSpscQueue() : m_head(0), m_tail(0), m_stats() {}
+
+    // Called by the producer.  Returns false if the pipeline was aborted
+    bool push(T&& item, const std::atomic<bool>& abort)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_head.load(std::memory_order_acquire) == N)
+        {
+            double start = monotonic_ms();
+            ++m_stats.full_waits;
+            for (int spins = 0; tail - m_head.load(std::memory_order_acquire) == N; ++spins)
+            {
+                if (abort.load(std::memory_order_relaxed)) return false;
+                wait(spins);
+            }
+            m_stats.full_wait_ms += monotonic_ms() - start;
+        }
+
+        m_slot[tail % N] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        ++m_stats.pushes;
+        m_stats.depth_sum += tail + 1 - m_head.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    // Called by the consumer.  Returns false if the pipeline was aborted
+    bool pop(T* p_item, const std::atomic<bool>& abort)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+
+        if (m_tail.load(std::memory_order_acquire) == head)
+        {
+            double start = monotonic_ms();
+            ++m_stats.empty_waits;
+            for (int spins = 0; m_tail.load(std::memory_order_acquire) == head; ++spins)
+            {
+                if (abort.load(std::memory_order_relaxed)) return false;
+                wait(spins);
+            }
+            m_stats.empty_wait_ms += monotonic_ms() - start;
+        }
+
+        *p_item = std::move(m_slot[head % N]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only meaningful once both threads are done with the queue
+    const queue_stats_t& stats() const {return m_stats;}
+
+    // The number of slots in the queue
+    size_t capacity() const {return N;}
+
+protected:
+
+    // Waits a little while for the other side.  A short wait is likely, so we
+    // start by yielding, but a long wait mustn't steal CPU from the very stage
+    // we're waiting on, so after a while we sleep instead
+    static void wait(int spins)
+    {
+        if (spins < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    T                                m_slot[N];
+    alignas(64) std::atomic<size_t>  m_head;
+    alignas(64) std::atomic<size_t>  m_tail;
+    alignas(64) queue_stats_t        m_stats;
+};
+//-----------------------------------------------------------------------------
+
+// One connection's trip through the pipeline
+struct pipeline_job_t
+{
+    // The connection whose register file is parsed and rendered
+    connection_t* conn;
+
+    // True if the connection's registers were already filled in from a cache
+    bool          cached;
+
+    // Filled in by the pipeline: the stamp of the file that was parsed
+    bool          stamped;
+    file_stamp_t  stamp;
+};
+
+// The render stage.  These are called on the thread that runs the pipeline,
+// in job order, and each register is handed over as soon as it's parsed
+struct pipeline_renderer_t
+{
+    std::function<void(const pipeline_job_t&)>                begin;
+    std::function<void(const pipeline_job_t&, const vreg_t&)> reg;
+    std::function<void(const pipeline_job_t&)>                end;
+};
+
+// Where the time went in each stage of the pipeline
+struct pipeline_stats_t
+{
+    bool          ran, threaded;
+    double        total_ms;
+    double        read_ms, parse_ms, render_ms;
+    queue_stats_t chunks, regs;
+    size_t        chunk_capacity, reg_capacity;
+};
+
+// Reads, parses and renders the register files of a list of connections,
+// with each stage on its own thread.  If "diag" is given, files that can't be
+// opened and problems in the files are recorded there, and every job still
+// runs.  Otherwise, the first problem throws
+void run_pipeline(std::vector<pipeline_job_t>& jobs, CFilePrefetcher& prefetcher,
+                  const pipeline_renderer_t& renderer, pipeline_stats_t* p_stats,
+                  CDiagnostics* diag = nullptr);
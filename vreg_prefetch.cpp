@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "vreg_prefetch.h"
+
+using std::vector;
+using std::string;
+
+
+//=============================================================================
+// read_whole_file() - Reads a file into memory.  The stamp is fetched before
+//                     the file is read, so if the file changes while we're
+//                     reading it, the stamp won't match the next time around
+//=============================================================================
+void read_whole_file(const string& filename, prefetched_file_t* p_file)
+{
+    struct stat st;
+    char        buffer[65536];
+    ssize_t     n;
+
+    p_file->ok       = false;
+    p_file->stamped  = get_file_stamp(filename, &p_file->stamp);
+    p_file->contents.clear();
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    // Reserve room for the whole file up front
+    if (fstat(fd, &st) == 0) p_file->contents.reserve(st.st_size);
+
+    // Read the file
+    while ((n = read(fd, buffer, sizeof buffer)) > 0) p_file->contents.append(buffer, n);
+
+    close(fd);
+    p_file->ok = (n == 0);
+}
+//=============================================================================
+
+
+//=============================================================================
+// start() - Queues up a list of files and starts the threads that read them
+//=============================================================================
+void CFilePrefetcher::start(const vector<string>& filenames, int max_threads)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& filename : filenames)
+    {
+        if (m_entry.count(filename)) continue;
+        m_entry[filename].state = QUEUED;
+        m_queue.push_back(filename);
+    }
+
+    // There's no point in having more threads than files
+    size_t wanted = std::min((size_t)max_threads, m_queue.size());
+
+    while (m_thread.size() < wanted) m_thread.emplace_back(&CFilePrefetcher::reader, this);
+}
+//=============================================================================
+
+
+//=============================================================================
+// reader() - Reads queued files until there are none left
+//=============================================================================
+void CFilePrefetcher::reader()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (!m_stopping && !m_queue.empty())
+    {
+        string filename = m_queue.front();
+        m_queue.pop_front();
+
+        // If the caller got to this file first, it's already been read
+        auto it = m_entry.find(filename);
+        if (it == m_entry.end() || it->second.state != QUEUED) continue;
+        entry_t& entry = it->second;
+        entry.state = READING;
+
+        // Read the file without holding the lock
+        prefetched_file_t file;
+        lock.unlock();
+        read_whole_file(filename, &file);
+        lock.lock();
+
+        // Hand the contents to whoever is waiting for them
+        entry.file  = std::move(file);
+        entry.state = DONE;
+        m_done.notify_all();
+    }
+}
+//=============================================================================
+
+
+//=============================================================================
+// fetch() - Hands the caller the contents of a file.  If no thread has started
+//           reading the file yet, we read it ourselves rather than wait
+//=============================================================================
+void CFilePrefetcher::fetch(const string& filename, prefetched_file_t* p_file)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_entry.find(filename);
+
+    // If this file isn't being prefetched, or hasn't been started, read it now
+    if (it == m_entry.end() || it->second.state == QUEUED)
+    {
+        if (it != m_entry.end()) it->second.state = READING;
+        lock.unlock();
+        read_whole_file(filename, p_file);
+        lock.lock();
+        if (it != m_entry.end()) m_entry.erase(it);
+        return;
+    }
+
+    // Otherwise, wait for a reader thread to finish with it
+    m_done.wait(lock, [&]{return it->second.state == DONE;});
+    *p_file = std::move(it->second.file);
+    m_entry.erase(it);
+}
+//=============================================================================
+
+
+//=============================================================================
+// stop() - Abandons any files that haven't been started, waits for the reader
+//          threads to finish and forgets everything that was read
+//=============================================================================
+void CFilePrefetcher::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_queue.clear();
+    }
+
+    for (auto& t : m_thread) t.join();
+
+    m_thread.clear();
+    m_entry.clear();
+    m_stopping = false;
+}
+//=============================================================================
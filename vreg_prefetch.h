@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "vreg_serve.h"
+
+// The contents of a file, as read by the prefetcher
+struct prefetched_file_t
+{
+    // True if the file could be opened and read
+    bool         ok;
+
+    // True if "stamp" identifies the version of the file that was read
+    bool         stamped;
+    file_stamp_t stamp;
+
+    // Everything that was in the file
+    std::string  contents;
+};
+
+//-----------------------------------------------------------------------------
+// CFilePrefetcher - Reads a list of files into memory on a pool of threads,
+//                   so that the latency of opening and reading each of them
+//                   overlaps with the parsing of the ones before it
+//-----------------------------------------------------------------------------
+class CFilePrefetcher
+{
+public:
+
+    CFilePrefetcher() : m_stopping(false) {}
+    ~CFilePrefetcher() {stop();}
+
+    // Starts reading files in the background on up to "max_threads" threads
+    void start(const std::vector<std::string>& filenames, int max_threads = 8);
+
+    // Hands the caller a file's contents, waiting for them if they're still being
+    // read.  A file that was never handed to start() is read on the spot
+    void fetch(const std::string& filename, prefetched_file_t* p_file);
+
+    // Waits for the threads to finish and forgets every file
+    void stop();
+
+protected:
+
+    // The state of a file that was handed to start()
+    enum state_t {QUEUED, READING, DONE};
+    struct entry_t
+    {
+        state_t           state;
+        prefetched_file_t file;
+    };
+
+    // The body of a reader thread
+    void reader();
+
+    std::mutex                     m_mutex;
+    std::condition_variable        m_done;
+    std::map<std::string, entry_t> m_entry;
+    std::deque<std::string>        m_queue;
+    std::vector<std::thread>       m_thread;
+    bool                           m_stopping;
+};
+//-----------------------------------------------------------------------------
+
+// Reads a file into memory, fetching its stamp first
+void read_whole_file(const std::string& filename, prefetched_file_t* p_file);
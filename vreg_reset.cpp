@@ -0,0 +1,178 @@
+#include "vreg_reset.h"
+#include "vreg_burst.h"
+
+using std::vector;
+using std::string;
+
+// One 32-bit word of a reset image
+struct reset_word_t
+{
+    uint32_t      offset;
+    uint32_t      value;
+    uint32_t      mask;
+    const vreg_t* reg;
+};
+
+
+//=============================================================================
+// verify_mask() - Returns the mask of register bits that have a meaningful
+//                 reset value when read back.  That's every field whose type
+//                 makes it readable
+//=============================================================================
+static uint64_t verify_mask(const vreg_t& reg)
+{
+    uint64_t result = 0;
+
+    for (auto& f : reg.field)
+    {
+        if (!f.type.empty() && (f.type[0] == 'R' || f.type[0] == 'r'))
+            result |= field_mask(f);
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// build_image() - Builds the list of reset words for a connection, sorted by
+//                 offset.  64-bit registers become two consecutive words
+//=============================================================================
+static vector<reset_word_t> build_image(const vector<vreg_t>& regs)
+{
+    vector<reset_word_t> result;
+    reset_word_t         word;
+
+    for (auto reg : sort_by_offset(regs))
+    {
+        // Registers without fields have no reset value to speak of
+        if (reg->field.empty()) continue;
+
+        uint64_t value = reset_value(*reg);
+        uint64_t mask  = verify_mask(*reg);
+
+        word.reg    = reg;
+        word.offset = reg->offset;
+        word.value  = (uint32_t)value;
+        word.mask   = (uint32_t)mask;
+        result.push_back(word);
+
+        if (reg->size == 64)
+        {
+            word.offset = reg->offset + 4;
+            word.value  = (uint32_t)(value >> 32);
+            word.mask   = (uint32_t)(mask  >> 32);
+            result.push_back(word);
+        }
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// build_bursts() - Merges runs of reset words at contiguous offsets into
+//                  burst descriptors
+//=============================================================================
+static vector<burst_t> build_bursts(const vector<reset_word_t>& image)
+{
+    vector<burst_t> result;
+
+    for (uint32_t i = 0; i < image.size(); ++i)
+    {
+        // If this word immediately follows the current burst, extend the burst
+        if (!result.empty())
+        {
+            burst_t& burst = result.back();
+            if (image[i].offset == burst.offset + burst.count * 4)
+            {
+                ++burst.count;
+                continue;
+            }
+        }
+
+        // Otherwise, this word starts a new burst
+        result.push_back({image[i].offset, 1, i});
+    }
+
+    return result;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_reset_image() - Writes a connection's reset image.
+//
+// The image is three parallel arrays sorted by offset: the offset of each
+// 32-bit word, its reset value, and the mask of bits that can be verified on
+// readback.  Runs of contiguous words are described by burst descriptors so
+// that the image can be programmed or verified with a handful of DMA or
+// memcpy transfers, and a pair of inline routines do the same thing word by
+// word through a pointer to the connection's base address
+//=============================================================================
+void write_reset_image(FILE* ofile, const vector<vreg_t>& regs, string ident)
+{
+    const char* id = ident.c_str();
+
+    // Build the reset image and the bursts that describe it
+    auto image  = build_image(regs);
+    auto bursts = build_bursts(image);
+
+    // If there are no registers with fields, there's no image to write
+    if (image.empty()) return;
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Reset image: %s\n", id);
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#define %-60s %u\n", (ident + "_RESET_WORDS").c_str(), (uint32_t)image.size());
+    fprintf(ofile, "#define %-60s %u\n", (ident + "_RESET_BURSTS").c_str(), (uint32_t)bursts.size());
+    fprintf(ofile, "\n");
+
+    fprintf(ofile, "static const uint32_t %s_reset_offset[] =\n{\n", id);
+    for (auto& w : image)
+        fprintf(ofile, "    0x%08x,    // %s\n", w.offset, w.reg->name.c_str());
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const uint32_t %s_reset_value[] =\n{\n", id);
+    for (auto& w : image)
+        fprintf(ofile, "    0x%08x,    // %s\n", w.value, w.reg->name.c_str());
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const uint32_t %s_reset_mask[] =\n{\n", id);
+    for (auto& w : image)
+        fprintf(ofile, "    0x%08x,    // %s\n", w.mask, w.reg->name.c_str());
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const fpga_burst_t %s_reset_burst[] =\n{\n", id);
+    for (auto& b : bursts)
+        fprintf(ofile, "    {0x%08x, %4u, %4u},\n", b.offset, b.count, b.first);
+    fprintf(ofile, "};\n\n");
+
+    // This routine writes the reset image through a pointer to the connection base
+    fprintf(ofile, "static inline void %s_reset_program(volatile uint32_t* base)\n", id);
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    for (uint32_t b = 0; b < %s_RESET_BURSTS; ++b)\n", id);
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        const fpga_burst_t* burst = &%s_reset_burst[b];\n", id);
+    fprintf(ofile, "        volatile uint32_t* out = base + burst->offset / 4;\n");
+    fprintf(ofile, "        for (uint32_t i = 0; i < burst->count; ++i) out[i] = %s_reset_value[burst->first + i];\n", id);
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "}\n\n");
+
+    // This routine reads back the registers and counts those that don't match
+    fprintf(ofile, "static inline uint32_t %s_reset_verify(const volatile uint32_t* base)\n", id);
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    uint32_t errors = 0;\n");
+    fprintf(ofile, "    for (uint32_t i = 0; i < %s_RESET_WORDS; ++i)\n", id);
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        uint32_t value = base[%s_reset_offset[i] / 4];\n", id);
+    fprintf(ofile, "        if ((value ^ %s_reset_value[i]) & %s_reset_mask[i]) ++errors;\n", id, id);
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "    return errors;\n");
+    fprintf(ofile, "}\n");
+
+    // Leave a couple of blank lines after every reset image
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "vreg_parser.h"
+
+// Writes the reset image, burst descriptors and program/verify routines for a connection
+void write_reset_image(FILE* ofile, const std::vector<vreg_t>& regs, std::string ident);
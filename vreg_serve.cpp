@@ -0,0 +1,213 @@
+#include <stdexcept>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "vreg_serve.h"
+
+using std::vector;
+using std::string;
+
+
+//=============================================================================
+// write_all() - Writes a buffer to a socket.  Returns false on error
+//=============================================================================
+static bool write_all(int fd, const void* data, size_t length)
+{
+    const char* p = (const char*)data;
+
+    while (length)
+    {
+        ssize_t n = write(fd, p, length);
+        if (n <= 0) return false;
+        p      += n;
+        length -= n;
+    }
+
+    return true;
+}
+//=============================================================================
+
+
+//=============================================================================
+// read_all() - Reads exactly "length" bytes from a socket.  Returns false on
+//              error or end-of-file
+//=============================================================================
+static bool read_all(int fd, void* data, size_t length)
+{
+    char* p = (char*)data;
+
+    while (length)
+    {
+        ssize_t n = read(fd, p, length);
+        if (n <= 0) return false;
+        p      += n;
+        length -= n;
+    }
+
+    return true;
+}
+//=============================================================================
+
+
+//=============================================================================
+// send_strings() - Sends a message: a count of strings, followed by each
+//                  string as a length and its bytes
+//=============================================================================
+static bool send_strings(int fd, const vector<string>& strings)
+{
+    string   message;
+    uint32_t count = strings.size();
+
+    message.append((const char*)&count, sizeof count);
+    for (auto& s : strings)
+    {
+        uint32_t length = s.size();
+        message.append((const char*)&length, sizeof length);
+        message.append(s);
+    }
+
+    return write_all(fd, message.data(), message.size());
+}
+//=============================================================================
+
+
+//=============================================================================
+// recv_strings() - Receives a message that was sent with send_strings()
+//=============================================================================
+static bool recv_strings(int fd, vector<string>* p_strings)
+{
+    uint32_t count, length;
+
+    p_strings->clear();
+
+    if (!read_all(fd, &count, sizeof count)) return false;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!read_all(fd, &length, sizeof length)) return false;
+        string s(length, 0);
+        if (length && !read_all(fd, &s[0], length)) return false;
+        p_strings->push_back(s);
+    }
+
+    return true;
+}
+//=============================================================================
+
+
+//=============================================================================
+// make_address() - Fills in the socket address for a socket path
+//=============================================================================
+static sockaddr_un make_address(const char* socket_path)
+{
+    sockaddr_un address;
+
+    if (strlen(socket_path) >= sizeof address.sun_path)
+        throw std::runtime_error(string("socket path too long: ") + socket_path);
+
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    return address;
+}
+//=============================================================================
+
+
+//=============================================================================
+// serve() - Runs the generation daemon.
+//
+// Every request is the client's working directory followed by its command
+// line.  Requests are handled one at a time, in the client's working
+// directory, so relative filenames mean what the client expects them to.
+// Whatever the handler keeps between requests (the parsed inputs) is what
+// makes a request cheaper than running xlate_vreg from scratch
+//=============================================================================
+int serve(const char* socket_path, request_handler_t handler)
+{
+    vector<string> request;
+    string         output, messages, error;
+
+    // A client that goes away mustn't take the daemon with it
+    signal(SIGPIPE, SIG_IGN);
+
+    // Create the listening socket, replacing any stale socket file
+    sockaddr_un address = make_address(socket_path);
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd < 0) throw std::runtime_error("can't create socket");
+    unlink(socket_path);
+    if (bind(sd, (sockaddr*)&address, sizeof address) != 0 || listen(sd, 64) != 0)
+    {
+        close(sd);
+        throw std::runtime_error(string("can't listen on ") + socket_path);
+    }
+
+    while (true)
+    {
+        int fd = accept(sd, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        // Fetch the request.  If it's incomplete, the client is gone
+        if (!recv_strings(fd, &request) || request.empty())
+        {
+            close(fd);
+            continue;
+        }
+
+        // Move to the client's working directory and handle the request
+        int status = 1;
+        output.clear();
+        messages.clear();
+        if (chdir(request[0].c_str()) != 0)
+            error = "can't change directory to " + request[0];
+        else
+            status = handler(vector<string>(request.begin() + 1, request.end()), &output, &messages, &error);
+
+        // Send the result back to the client
+        send_strings(fd, {std::to_string(status), output, messages, error});
+        close(fd);
+        error.clear();
+    }
+}
+//=============================================================================
+
+
+//=============================================================================
+// serve_client() - Sends a command line to the daemon, prints what it sends
+//                  back, and returns its exit status
+//=============================================================================
+int serve_client(const char* socket_path, const char** argv)
+{
+    vector<string> request, response;
+    char           cwd[PATH_MAX];
+
+    // The request is our working directory followed by the command line
+    if (getcwd(cwd, sizeof cwd) == nullptr) throw std::runtime_error("can't get working directory");
+    request.push_back(cwd);
+    while (*argv) request.push_back(*argv++);
+
+    // Connect to the daemon
+    sockaddr_un address = make_address(socket_path);
+    int sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd < 0) throw std::runtime_error("can't create socket");
+    if (connect(sd, (sockaddr*)&address, sizeof address) != 0)
+    {
+        close(sd);
+        throw std::runtime_error(string("can't connect to ") + socket_path);
+    }
+
+    // Send the request and wait for the response
+    bool ok = send_strings(sd, request) && recv_strings(sd, &response) && response.size() == 4;
+    close(sd);
+    if (!ok) throw std::runtime_error("no response from server");
+
+    // Report the result exactly as a stand-alone run would have
+    fwrite(response[1].data(), 1, response[1].size(), stdout);
+    fwrite(response[2].data(), 1, response[2].size(), stderr);
+    if (!response[3].empty()) fprintf(stderr, "xlate_vreg: %s\n", response[3].c_str());
+    return atoi(response[0].c_str());
+}
+//=============================================================================
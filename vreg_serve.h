@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include "vreg_stamp.h"
+
+//-----------------------------------------------------------------------------
+// CFileCache - Holds values that were parsed from files, and hands them back
+//              for as long as the file they came from hasn't changed
+//-----------------------------------------------------------------------------
+template <typename T> class CFileCache
+{
+public:
+
+    // Returns the value stored under "key" if "filename" hasn't changed since, else nullptr
+    const T* find(const std::string& key, const std::string& filename)
+    {
+        file_stamp_t stamp;
+        auto it = m_entry.find(key);
+        if (it == m_entry.end()) return nullptr;
+        if (get_file_stamp(filename, &stamp) && stamp == it->second.stamp) return &it->second.value;
+        m_entry.erase(it);
+        return nullptr;
+    }
+
+    // Returns true if nothing is stored
+    bool empty() const {return m_entry.empty();}
+
+    // Stores a value parsed from a file whose stamp was fetched before it was parsed
+    void store(const std::string& key, const file_stamp_t& stamp, const T& value)
+    {
+        m_entry[key] = {stamp, value};
+    }
+
+protected:
+
+    struct entry_t
+    {
+        file_stamp_t stamp;
+        T            value;
+    };
+
+    std::map<std::string, entry_t> m_entry;
+};
+//-----------------------------------------------------------------------------
+
+// Handles one request: fills in the text for stdout, any other text for stderr (such as -stats), and
+// an error message, and returns an exit status
+typedef std::function<int(const std::vector<std::string>& args, std::string* p_output,
+                          std::string* p_messages, std::string* p_error)> request_handler_t;
+
+// Runs the generation daemon on a Unix domain socket.  Never returns unless there's an error
+int serve(const char* socket_path, request_handler_t handler);
+
+// Hands a command line to the daemon and reports the result.  Returns the exit status
+int serve_client(const char* socket_path, const char** argv);
@@ -0,0 +1,147 @@
+#include <strings.h>
+#include "vreg_shadow.h"
+
+using std::vector;
+using std::string;
+
+
+//=============================================================================
+// is_shadowable() - Returns true if a register can be cached in host memory.
+//                   That's any register whose fields are all plain "RW",
+//                   since its value only ever changes when software writes it
+//=============================================================================
+bool is_shadowable(const vreg_t& reg)
+{
+    if (reg.field.empty()) return false;
+
+    for (auto& f : reg.field)
+    {
+        if (strcasecmp(f.type.c_str(), "RW") != 0) return false;
+    }
+
+    return true;
+}
+//=============================================================================
+
+
+//=============================================================================
+// has_writable_bits() - Returns true if any field of a register is writable
+//=============================================================================
+static bool has_writable_bits(const vreg_t& reg)
+{
+    for (auto& f : reg.field) if (is_writable(f)) return true;
+    return false;
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_shadow_registers() - Writes a struct that shadows every RW register
+//                            of a connection, along with read and write
+//                            accessors for every register.
+//
+// Writes to a shadowed register go through to the hardware and are also
+// saved in the shadow, and reads come from the shadow.  Registers that have
+// any RO, W1C or otherwise volatile fields are always read from hardware
+//=============================================================================
+void write_shadow_registers(FILE* ofile, const vector<vreg_t>& regs, string ident)
+{
+    const char* id = ident.c_str();
+    int         shadow_count = 0;
+
+    // If there are no registers, there's nothing to write
+    if (regs.empty()) return;
+
+    // We want the registers in the order they appear in the address space
+    auto sorted = sort_by_offset(regs);
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Shadow registers: %s\n", id);
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "typedef struct\n");
+    fprintf(ofile, "{\n");
+    for (auto reg : sorted)
+    {
+        if (!is_shadowable(*reg)) continue;
+        fprintf(ofile, "    uint%u_t %s;\n", reg->size, reg->short_name.c_str());
+        ++shadow_count;
+    }
+
+    // C doesn't allow an empty struct
+    if (shadow_count == 0) fprintf(ofile, "    uint32_t unused;\n");
+
+    fprintf(ofile, "} %s_shadow_t;\n\n", id);
+
+    // This routine sets the shadow registers to their reset values
+    fprintf(ofile, "static inline void %s_shadow_init(%s_shadow_t* shadow)\n", id, id);
+    fprintf(ofile, "{\n");
+    if (shadow_count == 0) fprintf(ofile, "    shadow->unused = 0;\n");
+    for (auto reg : sorted)
+    {
+        if (!is_shadowable(*reg)) continue;
+        fprintf(ofile, "    shadow->%s = 0x%lxULL;\n", reg->short_name.c_str(), reset_value(*reg));
+    }
+    fprintf(ofile, "}\n\n");
+
+    // This routine reloads the shadow registers from the hardware
+    fprintf(ofile, "static inline void %s_shadow_sync(%s_shadow_t* shadow, const volatile void* base)\n", id, id);
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    const volatile uint8_t* p = (const volatile uint8_t*)base;\n");
+    if (shadow_count == 0) fprintf(ofile, "    (void)shadow; (void)p;\n");
+    for (auto reg : sorted)
+    {
+        if (!is_shadowable(*reg)) continue;
+        fprintf
+        (
+            ofile, "    shadow->%s = *(const volatile uint%u_t*)(p + 0x%04x);\n",
+            reg->short_name.c_str(), reg->size, reg->offset
+        );
+    }
+    fprintf(ofile, "}\n\n");
+
+    // Now write the accessors for each register
+    for (auto reg : sorted)
+    {
+        const char* rname = reg->name.c_str();
+        const char* sname = reg->short_name.c_str();
+        uint32_t    size  = reg->size;
+
+        fprintf
+        (
+            ofile, "static inline uint%u_t %s_read(const %s_shadow_t* shadow, const volatile void* base)\n",
+            size, rname, id
+        );
+        fprintf(ofile, "{\n");
+        if (is_shadowable(*reg))
+        {
+            fprintf(ofile, "    (void)base;\n");
+            fprintf(ofile, "    return shadow->%s;\n", sname);
+        }
+        else
+        {
+            fprintf(ofile, "    (void)shadow;\n");
+            fprintf(ofile, "    return *(const volatile uint%u_t*)((const volatile uint8_t*)base + 0x%04x);\n", size, reg->offset);
+        }
+        fprintf(ofile, "}\n\n");
+
+        // Registers with no writable bits don't get a "write" accessor
+        if (!has_writable_bits(*reg)) continue;
+
+        fprintf
+        (
+            ofile, "static inline void %s_write(%s_shadow_t* shadow, volatile void* base, uint%u_t value)\n",
+            rname, id, size
+        );
+        fprintf(ofile, "{\n");
+        if (is_shadowable(*reg))
+            fprintf(ofile, "    shadow->%s = value;\n", sname);
+        else
+            fprintf(ofile, "    (void)shadow;\n");
+        fprintf(ofile, "    *(volatile uint%u_t*)((volatile uint8_t*)base + 0x%04x) = value;\n", size, reg->offset);
+        fprintf(ofile, "}\n\n");
+    }
+
+    // Leave a blank line after the accessors
+    fprintf(ofile, "\n");
+}
+//=============================================================================
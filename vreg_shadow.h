@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "vreg_parser.h"
+
+// Returns true if every field of a register is plain read/write
+bool is_shadowable(const vreg_t& reg);
+
+// Writes a shadow-register struct and accessors for a connection
+void write_shadow_registers(FILE* ofile, const std::vector<vreg_t>& regs, std::string ident);
@@ -0,0 +1,125 @@
+#include "vreg_snapshot.h"
+
+using std::vector;
+using std::string;
+
+// Describes where one field lives in a snapshot
+struct snap_field_t
+{
+    string   name;
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t shift;
+    uint64_t mask;
+};
+
+
+//=============================================================================
+// write_snapshot_decoder() - Writes the layout of a register snapshot and a
+//                            routine that decodes snapshots into fields.
+//
+// A snapshot is a contiguous array of 32-bit words covering every register
+// of the connection, exactly as a bulk read of the register space would
+// return them.  Every field is described by a row in a set of precomputed
+// tables: the word holding bits 31:0 of its register, the word holding bits
+// 63:32, a shift and a mask.  For 32-bit registers both words are the same,
+// so a single branch-free expression decodes every field, and the decode
+// loop over snapshots has no dependencies the compiler can't vectorize
+//=============================================================================
+void write_snapshot_decoder(FILE* ofile, const vector<vreg_t>& regs, string ident)
+{
+    vector<snap_field_t> fields;
+    snap_field_t         field;
+    const char*          id = ident.c_str();
+
+    // We need the registers in the order they appear in the address space
+    auto sorted = sort_by_offset(regs);
+
+    // If there are no registers, there's no snapshot
+    if (sorted.empty()) return;
+
+    // The snapshot runs from the first register to the end of the last one
+    uint32_t first = sorted.front()->offset;
+    uint32_t last  = first;
+    for (auto reg : sorted)
+    {
+        uint32_t end = reg->offset + reg->size / 8;
+        if (end > last) last = end;
+    }
+    uint32_t words = (last - first) / 4;
+
+    // Build a table entry for every field of every register
+    for (auto reg : sorted)
+    {
+        for (auto& f : reg->field)
+        {
+            field.name  = reg->short_name + "_" + f.name;
+            field.lo    = (reg->offset - first) / 4;
+            field.hi    = (reg->size == 64) ? field.lo + 1 : field.lo;
+            field.shift = f.pos;
+            field.mask  = field_mask(f) >> f.pos;
+            fields.push_back(field);
+        }
+    }
+
+    // If there are no fields, there's nothing to decode
+    if (fields.empty()) return;
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Snapshot decoder: %s\n", id);
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "#define %-60s 0x%04x\n", (ident + "_SNAPSHOT_OFFSET").c_str(), first);
+    fprintf(ofile, "#define %-60s %u\n",     (ident + "_SNAPSHOT_WORDS" ).c_str(), words);
+    fprintf(ofile, "#define %-60s %u\n",     (ident + "_SNAPSHOT_FIELDS").c_str(), (uint32_t)fields.size());
+    fprintf(ofile, "\n");
+
+    // The index of each field in the decoded output
+    fprintf(ofile, "enum\n{\n");
+    for (uint32_t i = 0; i < fields.size(); ++i)
+    {
+        string name = ident + "_SNAP_" + fields[i].name;
+        fprintf(ofile, "    %-60s = %u,\n", name.c_str(), i);
+    }
+    fprintf(ofile, "};\n\n");
+
+    // Word indexes are 16 bits wide unless the snapshot is too big for that
+    const char* index_type = (words > 0x10000) ? "uint32_t" : "uint16_t";
+
+    fprintf(ofile, "static const %s %s_snapshot_lo[] =\n{\n", index_type, id);
+    for (auto& f : fields) fprintf(ofile, "    %4u,    // %s\n", f.lo, f.name.c_str());
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const %s %s_snapshot_hi[] =\n{\n", index_type, id);
+    for (auto& f : fields) fprintf(ofile, "    %4u,    // %s\n", f.hi, f.name.c_str());
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const uint8_t %s_snapshot_shift[] =\n{\n", id);
+    for (auto& f : fields) fprintf(ofile, "    %4u,    // %s\n", f.shift, f.name.c_str());
+    fprintf(ofile, "};\n\n");
+
+    fprintf(ofile, "static const uint64_t %s_snapshot_mask[] =\n{\n", id);
+    for (auto& f : fields) fprintf(ofile, "    0x%016lxULL,    // %s\n", f.mask, f.name.c_str());
+    fprintf(ofile, "};\n\n");
+
+    // Decodes "count" consecutive snapshots into out[field * count + n]
+    fprintf(ofile, "static inline void %s_decode_snapshots(const uint32_t* raw, size_t count, uint64_t* out)\n", id);
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    for (uint32_t f = 0; f < %s_SNAPSHOT_FIELDS; ++f)\n", id);
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        const uint32_t* lo    = raw + %s_snapshot_lo[f];\n", id);
+    fprintf(ofile, "        const uint32_t* hi    = raw + %s_snapshot_hi[f];\n", id);
+    fprintf(ofile, "        const uint32_t  shift = %s_snapshot_shift[f];\n", id);
+    fprintf(ofile, "        const uint64_t  mask  = %s_snapshot_mask[f];\n", id);
+    fprintf(ofile, "        uint64_t*       dst   = out + (size_t)f * count;\n");
+    fprintf(ofile, "        for (size_t n = 0; n < count; ++n)\n");
+    fprintf(ofile, "        {\n");
+    fprintf(ofile, "            uint64_t word = lo[n * %s_SNAPSHOT_WORDS] | ((uint64_t)hi[n * %s_SNAPSHOT_WORDS] << 32);\n", id, id);
+    fprintf(ofile, "            dst[n] = (word >> shift) & mask;\n");
+    fprintf(ofile, "        }\n");
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "}\n");
+
+    // Leave a couple of blank lines after every decoder
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "vreg_parser.h"
+
+// Writes a snapshot layout and a table-driven field decoder for a connection
+void write_snapshot_decoder(FILE* ofile, const std::vector<vreg_t>& regs, std::string ident);
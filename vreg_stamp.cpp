@@ -0,0 +1,35 @@
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "vreg_stamp.h"
+
+using std::string;
+
+
+//=============================================================================
+// get_file_stamp() - Fetches the modification time, size and inode of a file
+//=============================================================================
+bool get_file_stamp(const string& filename, file_stamp_t* p_stamp)
+{
+    struct stat st;
+
+    if (stat(filename.c_str(), &st) != 0) return false;
+
+    p_stamp->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    p_stamp->size     = st.st_size;
+    p_stamp->inode    = st.st_ino;
+    return true;
+}
+//=============================================================================
+
+
+//=============================================================================
+// absolute_path() - Returns the absolute path of a file.  Cache keys are
+//                   absolute paths because every client has its own cwd
+//=============================================================================
+string absolute_path(const string& filename)
+{
+    char buffer[PATH_MAX];
+    return realpath(filename.c_str(), buffer) ? string(buffer) : filename;
+}
+//=============================================================================
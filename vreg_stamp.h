@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Identifies one version of a file's contents
+struct file_stamp_t
+{
+    int64_t  mtime_ns;
+    int64_t  size;
+    uint64_t inode;
+
+    bool operator==(const file_stamp_t& rhs) const
+    {
+        return mtime_ns == rhs.mtime_ns && size == rhs.size && inode == rhs.inode;
+    }
+};
+
+// Fetches the stamp of a file.  Returns false if the file doesn't exist
+bool get_file_stamp(const std::string& filename, file_stamp_t* p_stamp);
+
+// Returns the absolute path of a file, or the filename unchanged if it doesn't exist
+std::string absolute_path(const std::string& filename);
@@ -0,0 +1,111 @@
+#include <stdexcept>
+#include "vreg_struct.h"
+
+using std::vector;
+using std::string;
+
+
+//=============================================================================
+// write_struct_preamble() - Writes the macros that every struct overlay
+//                           depends on
+//=============================================================================
+void write_struct_preamble(FILE* ofile)
+{
+    fprintf(ofile, "#ifdef __cplusplus\n");
+    fprintf(ofile, "#define FPGA_REG_STATIC_ASSERT static_assert\n");
+    fprintf(ofile, "#else\n");
+    fprintf(ofile, "#define FPGA_REG_STATIC_ASSERT _Static_assert\n");
+    fprintf(ofile, "#endif\n");
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_struct_overlay() - Writes a packed struct of volatile members that
+//                          can be laid over a connection's register space.
+//
+// Gaps between registers are filled with reserved words, and every member's
+// offset is checked at compile time by a static assertion
+//=============================================================================
+void write_struct_overlay(FILE* ofile, const vector<vreg_t>& regs, string ident)
+{
+    string   member;
+    uint32_t cursor = 0;
+    int      reserved_count = 0;
+
+    // If there are no registers, there's nothing to overlay
+    if (regs.empty()) return;
+
+    // This is the name of the struct type
+    string type_name = ident + "_regs_t";
+
+    // We need the registers in the order they appear in the address space
+    auto sorted = sort_by_offset(regs);
+
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// Register overlay: %s\n", type_name.c_str());
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "typedef struct __attribute__((packed))\n");
+    fprintf(ofile, "{\n");
+
+    for (auto reg : sorted)
+    {
+        // If this register overlaps the one before it, we can't lay out a struct
+        if (reg->offset < cursor)
+        {
+            throw std::runtime_error
+            (
+                "register " + reg->name + " overlaps the register before it"
+            );
+        }
+
+        // If there is a gap before this register, pad it out with reserved words
+        if (reg->offset > cursor)
+        {
+            uint32_t words = (reg->offset - cursor) / 4;
+            member = "_reserved" + std::to_string(reserved_count++) + "[" + std::to_string(words) + "];";
+            fprintf(ofile, "    uint32_t          %-40s // 0x%04x\n", member.c_str(), cursor);
+            cursor = reg->offset;
+        }
+
+        // Output the member for this register
+        member = reg->short_name + ";";
+        if (reg->size == 64)
+            fprintf(ofile, "    volatile uint64_t %-40s // 0x%04x\n", member.c_str(), cursor);
+        else
+            fprintf(ofile, "    volatile uint32_t %-40s // 0x%04x\n", member.c_str(), cursor);
+
+        // And point to the byte just past this register
+        cursor += reg->size / 8;
+    }
+
+    fprintf(ofile, "} %s;\n\n", type_name.c_str());
+
+    // Have the compiler confirm that every member is where we think it is
+    for (auto reg : sorted)
+    {
+        fprintf
+        (
+            ofile,
+            "FPGA_REG_STATIC_ASSERT(offsetof(%s, %s) == 0x%04x, \"%s layout\");\n",
+            type_name.c_str(),
+            reg->short_name.c_str(),
+            reg->offset,
+            type_name.c_str()
+        );
+    }
+
+    fprintf
+    (
+        ofile,
+        "FPGA_REG_STATIC_ASSERT(sizeof(%s) == 0x%04x, \"%s size\");\n",
+        type_name.c_str(),
+        cursor,
+        type_name.c_str()
+    );
+
+    // Leave a couple of blank lines after every struct
+    fprintf(ofile, "\n\n");
+}
+//=============================================================================
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "vreg_parser.h"
+
+// Writes the macros that the struct overlays depend on
+void write_struct_preamble(FILE* ofile);
+
+// Writes a packed, volatile struct that overlays a connection's registers
+void write_struct_overlay(FILE* ofile, const std::vector<vreg_t>& regs, std::string ident);
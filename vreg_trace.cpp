@@ -0,0 +1,375 @@
+#include "vreg_trace.h"
+
+using std::vector;
+using std::string;
+using std::map;
+
+
+//=============================================================================
+// This is the fixed part of the tracing support.  It follows the register and
+// field tables, and it's only compiled when FPGA_REG_TRACE is defined
+//=============================================================================
+static const char* trace_text = R"(
+        //---------------------------------------------------------------------
+        // counters() - One read counter and one write counter per register,
+        //              plus a pair for accesses to unknown addresses
+        //---------------------------------------------------------------------
+        inline std::atomic<uint64_t>* counters()
+        {
+            static std::atomic<uint64_t> counter[2 * (register_count + 1)];
+            return counter;
+        }
+
+        //---------------------------------------------------------------------
+        // index_of() - Returns the index of the register that contains an
+        //              address, or register_count if there isn't one
+        //---------------------------------------------------------------------
+        inline uint32_t index_of(uint64_t address)
+        {
+            uint32_t lo = 0, hi = register_count;
+            while (lo < hi)
+            {
+                uint32_t mid = (lo + hi) / 2;
+                if (registers[mid].address <= address) lo = mid + 1; else hi = mid;
+            }
+            if (lo == 0) return register_count;
+            const register_info& r = registers[lo - 1];
+            return (address < r.address + r.size / 8) ? lo - 1 : register_count;
+        }
+
+        //---------------------------------------------------------------------
+        // record - One traced access.  This is also the layout of a saved trace
+        //---------------------------------------------------------------------
+        struct record
+        {
+            uint64_t timestamp;     // Nanoseconds on the steady clock
+            uint64_t address;
+            uint64_t value;
+            uint32_t is_write;
+            uint32_t thread;        // Sequence number of the thread's ring
+        };
+
+    #ifdef FPGA_REG_TRACE_RING
+        static_assert((FPGA_REG_TRACE_RING & (FPGA_REG_TRACE_RING - 1)) == 0,
+                      "FPGA_REG_TRACE_RING must be a power of two");
+
+        //---------------------------------------------------------------------
+        // slot - One entry of a ring.  The words are atomic so that another
+        // thread can read them while the owner records, and "seq" tells the
+        // reader whether what it read is whole: it's odd while the slot is
+        // being written and 2 * (n + 1) once it holds the n'th access
+        //---------------------------------------------------------------------
+        struct slot
+        {
+            std::atomic<uint64_t> seq {0};
+            std::atomic<uint64_t> word[4];
+        };
+
+        //---------------------------------------------------------------------
+        // ring - The most recent FPGA_REG_TRACE_RING accesses of one thread.
+        //
+        // Only the owning thread writes to a ring, so recording an access is
+        // a handful of relaxed stores bracketed by the slot's sequence number,
+        // and a release of "head".  Rings are linked into a lock-free list
+        // when they're created and are never freed, so the trace of a thread
+        // survives the thread
+        //---------------------------------------------------------------------
+        struct ring
+        {
+            slot                  slot_[FPGA_REG_TRACE_RING];
+            std::atomic<uint64_t> head {0};
+            uint32_t              thread;
+            ring*                 next;
+        };
+
+        inline std::atomic<ring*>& ring_list()
+        {
+            static std::atomic<ring*> list {nullptr};
+            return list;
+        }
+
+        inline ring* this_thread_ring()
+        {
+            static std::atomic<uint32_t> thread_count {0};
+            static thread_local ring*    r = nullptr;
+
+            if (r == nullptr)
+            {
+                r = new ring;
+                r->thread = thread_count++;
+                r->next   = ring_list().load();
+                while (!ring_list().compare_exchange_weak(r->next, r));
+            }
+            return r;
+        }
+
+        // Calls "visit" for every recorded access of every thread, oldest
+        // first.  The threads may still be recording, so an access whose slot
+        // is overwritten while it's being read is skipped rather than torn
+        template <typename F> void for_each_record(F visit)
+        {
+            for (ring* r = ring_list().load(std::memory_order_acquire); r; r = r->next)
+            {
+                uint64_t head  = r->head.load(std::memory_order_acquire);
+                uint64_t first = (head > FPGA_REG_TRACE_RING) ? head - FPGA_REG_TRACE_RING : 0;
+                for (uint64_t i = first; i < head; ++i)
+                {
+                    slot& s = r->slot_[i & (FPGA_REG_TRACE_RING - 1)];
+                    if (s.seq.load(std::memory_order_acquire) != 2 * (i + 1)) continue;
+                    uint64_t flags = s.word[3].load(std::memory_order_relaxed);
+                    record   rec   = {s.word[0].load(std::memory_order_relaxed),
+                                      s.word[1].load(std::memory_order_relaxed),
+                                      s.word[2].load(std::memory_order_relaxed),
+                                      uint32_t(flags & 1), uint32_t(flags >> 32)};
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s.seq.load(std::memory_order_relaxed) != 2 * (i + 1)) continue;
+                    visit(rec);
+                }
+            }
+        }
+    #endif
+
+        //---------------------------------------------------------------------
+        // record_access() - Counts an access and, if there are trace rings,
+        //                   records it in the ring of the calling thread
+        //---------------------------------------------------------------------
+        inline void record_access(uint32_t index, uint64_t address, uint64_t value, bool is_write)
+        {
+            counters()[2 * index + is_write].fetch_add(1, std::memory_order_relaxed);
+
+        #ifdef FPGA_REG_TRACE_RING
+            ring*    r = this_thread_ring();
+            uint64_t h = r->head.load(std::memory_order_relaxed);
+            uint64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>
+                         (std::chrono::steady_clock::now().time_since_epoch()).count();
+            slot&    s = r->slot_[h & (FPGA_REG_TRACE_RING - 1)];
+            s.seq.store(2 * h + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.word[0].store(t,       std::memory_order_relaxed);
+            s.word[1].store(address, std::memory_order_relaxed);
+            s.word[2].store(value,   std::memory_order_relaxed);
+            s.word[3].store(uint64_t(r->thread) << 32 | is_write, std::memory_order_relaxed);
+            s.seq.store(2 * (h + 1), std::memory_order_release);
+            r->head.store(h + 1, std::memory_order_release);
+        #else
+            (void)address; (void)value;
+        #endif
+        }
+
+        //---------------------------------------------------------------------
+        // report() - Prints the access counts of every register that has been
+        //            accessed, busiest first
+        //---------------------------------------------------------------------
+        inline void report(FILE* ofile)
+        {
+            std::vector<uint32_t> busy;
+            std::atomic<uint64_t>* counter = counters();
+
+            for (uint32_t i = 0; i <= register_count; ++i)
+                if (counter[2 * i] || counter[2 * i + 1]) busy.push_back(i);
+
+            std::stable_sort(busy.begin(), busy.end(), [&](uint32_t a, uint32_t b)
+            {
+                return counter[2 * a] + counter[2 * a + 1] > counter[2 * b] + counter[2 * b + 1];
+            });
+
+            fprintf(ofile, "%12s %12s  register\n", "reads", "writes");
+            for (uint32_t i : busy)
+            {
+                fprintf(ofile, "%12llu %12llu  %s\n",
+                        (unsigned long long)counter[2 * i].load(),
+                        (unsigned long long)counter[2 * i + 1].load(),
+                        i < register_count ? registers[i].name : "[unknown address]");
+            }
+        }
+
+        //---------------------------------------------------------------------
+        // print() - Prints one access with its register and field names
+        //---------------------------------------------------------------------
+        inline void print(FILE* ofile, const record& r)
+        {
+            uint32_t index = index_of(r.address);
+
+            fprintf(ofile, "%llu t%u %c 0x%016llx 0x%016llx",
+                    (unsigned long long)r.timestamp, r.thread, r.is_write ? 'W' : 'R',
+                    (unsigned long long)r.address, (unsigned long long)r.value);
+
+            if (index == register_count)
+            {
+                fprintf(ofile, "  [unknown address]\n");
+                return;
+            }
+
+            const register_info& reg = registers[index];
+            fprintf(ofile, "  %s", reg.name);
+
+            // The upper word of a 64-bit register holds only the fields (or the
+            // parts of fields) in the upper 32 bits
+            uint64_t value = r.value, word = ~0ULL;
+            if (r.address != reg.address)
+            {
+                value <<= 32;
+                word    = 0xFFFFFFFF00000000ULL;
+            }
+
+            for (uint32_t f = reg.first_field; f < reg.first_field + reg.field_count; ++f)
+            {
+                const field_info& fi = fields[f];
+                uint64_t mask = (fi.width == 64) ? ~0ULL : (1ULL << fi.width) - 1;
+                if (((mask << fi.pos) & word) == 0) continue;
+                fprintf(ofile, " %s=0x%llx", fi.name, (unsigned long long)((value >> fi.pos) & mask));
+            }
+            fprintf(ofile, "\n");
+        }
+
+    #ifdef FPGA_REG_TRACE_RING
+        // Prints every recorded access of every thread
+        inline void dump(FILE* ofile)
+        {
+            for_each_record([&](const record& r) {print(ofile, r);});
+        }
+
+        // Writes every recorded access of every thread as raw records
+        inline void save(FILE* ofile)
+        {
+            for_each_record([&](const record& r) {fwrite(&r, sizeof r, 1, ofile);});
+        }
+    #endif
+
+        // Prints every access in a saved trace
+        inline void decode(FILE* ifile, FILE* ofile)
+        {
+            record r;
+            while (fread(&r, sizeof r, 1, ifile) == 1) print(ofile, r);
+        }
+    }
+}
+
+#define FPGA_REG_TRACE_READ(index, address, value)  ::fpga_reg::trace::record_access(index, address, value, false)
+#define FPGA_REG_TRACE_WRITE(index, address, value) ::fpga_reg::trace::record_access(index, address, value, true)
+#define FPGA_REG_TRACE_READ_ADDR(address, value)    FPGA_REG_TRACE_READ (::fpga_reg::trace::index_of(address), address, value)
+#define FPGA_REG_TRACE_WRITE_ADDR(address, value)   FPGA_REG_TRACE_WRITE(::fpga_reg::trace::index_of(address), address, value)
+#endif
+)";
+//=============================================================================
+
+
+//=============================================================================
+// write_trace_support() - Writes the register and field tables that tracing
+//                         uses to name an address, followed by the counters,
+//                         per-thread trace rings and decoder.
+//
+// Registers are numbered in the same order as the handles in the register map
+// (connections by address, registers by offset) so that the index carried by
+// a handle is also its position in the address-sorted register table.
+//
+// Everything is inside "#ifdef FPGA_REG_TRACE", so unless the program that
+// uses the library asks for tracing, the accessors carry no instrumentation
+//=============================================================================
+void write_trace_support(FILE* ofile, const map<uint64_t, connection_t>& connections)
+{
+    uint32_t reg_count = 0, field_count = 0;
+
+    fprintf(ofile, "\n");
+    fprintf(ofile, "#ifdef FPGA_REG_TRACE\n");
+    fprintf(ofile, "#include <cstdint>\n");
+    fprintf(ofile, "#include <cstdio>\n");
+    fprintf(ofile, "#include <atomic>\n");
+    fprintf(ofile, "#include <chrono>\n");
+    fprintf(ofile, "#include <vector>\n");
+    fprintf(ofile, "#include <algorithm>\n\n");
+    fprintf(ofile, "namespace fpga_reg\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    namespace trace\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        struct field_info\n");
+    fprintf(ofile, "        {\n");
+    fprintf(ofile, "            const char* name;\n");
+    fprintf(ofile, "            uint32_t    pos;\n");
+    fprintf(ofile, "            uint32_t    width;\n");
+    fprintf(ofile, "        };\n\n");
+    fprintf(ofile, "        struct register_info\n");
+    fprintf(ofile, "        {\n");
+    fprintf(ofile, "            uint64_t    address;\n");
+    fprintf(ofile, "            const char* name;\n");
+    fprintf(ofile, "            uint32_t    size;\n");
+    fprintf(ofile, "            uint32_t    first_field;\n");
+    fprintf(ofile, "            uint32_t    field_count;\n");
+    fprintf(ofile, "        };\n\n");
+
+    // The field table comes first, the register table indexes into it
+    fprintf(ofile, "        constexpr field_info fields[] =\n");
+    fprintf(ofile, "        {\n");
+    for (auto& c : connections)
+    {
+        for (auto reg : sort_by_offset(c.second.regs))
+        {
+            for (auto& f : reg->field)
+            {
+                fprintf(ofile, "            {\"%s\", %2u, %2u},\n", f.name.c_str(), f.pos, f.width);
+                ++field_count;
+            }
+        }
+    }
+    if (field_count == 0) fprintf(ofile, "            {\"\", 0, 0}\n");
+    fprintf(ofile, "        };\n\n");
+
+    fprintf(ofile, "        constexpr register_info registers[] =\n");
+    fprintf(ofile, "        {\n");
+    field_count = 0;
+    for (auto& c : connections)
+    {
+        for (auto reg : sort_by_offset(c.second.regs))
+        {
+            fprintf
+            (
+                ofile, "            {0x%016lxULL, \"%s\", %2u, %5u, %2u},\n",
+                c.second.address + reg->offset,
+                reg->name.c_str(),
+                reg->size,
+                field_count,
+                (uint32_t)reg->field.size()
+            );
+            field_count += reg->field.size();
+            ++reg_count;
+        }
+    }
+    if (reg_count == 0) fprintf(ofile, "            {0, \"\", 0, 0, 0}\n");
+    fprintf(ofile, "        };\n\n");
+
+    fprintf(ofile, "        constexpr uint32_t register_count = %u;\n", reg_count);
+
+    // And write the counters, rings and decoder
+    fputs(trace_text, ofile);
+}
+//=============================================================================
+
+
+//=============================================================================
+// write_trace_tool() - Writes a program that reads a trace saved with
+//                      fpga_reg::trace::save() and prints every access with
+//                      its register and field names
+//=============================================================================
+void write_trace_tool(FILE* ofile, string lib_header, const char* revision)
+{
+    fprintf(ofile, "//=====================================================\n");
+    fprintf(ofile, "// This file was auto-generated by xlate_vreg v%s\n", revision);
+    fprintf(ofile, "//            -->  DO NOT EDIT!  <-- \n");
+    fprintf(ofile, "//\n");
+    fprintf(ofile, "// usage: trace_decode [trace_file]\n");
+    fprintf(ofile, "//=====================================================\n");
+    fprintf(ofile, "#define FPGA_REG_TRACE\n");
+    fprintf(ofile, "#include \"%s\"\n\n", lib_header.c_str());
+    fprintf(ofile, "int main(int argc, char** argv)\n");
+    fprintf(ofile, "{\n");
+    fprintf(ofile, "    FILE* ifile = (argc > 1) ? fopen(argv[1], \"rb\") : stdin;\n");
+    fprintf(ofile, "    if (ifile == nullptr)\n");
+    fprintf(ofile, "    {\n");
+    fprintf(ofile, "        fprintf(stderr, \"can't open %%s\\n\", argv[1]);\n");
+    fprintf(ofile, "        return 1;\n");
+    fprintf(ofile, "    }\n");
+    fprintf(ofile, "    fpga_reg::trace::decode(ifile, stdout);\n");
+    fprintf(ofile, "    return 0;\n");
+    fprintf(ofile, "}\n");
+}
+//=============================================================================
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdio>
+#include <map>
+#include <string>
+#include "amap_parser.h"
+
+// Writes the access counters, trace rings and trace decoder of the C++ access library
+void write_trace_support(FILE* ofile, const std::map<uint64_t, connection_t>& connections);
+
+// Writes a stand-alone program that decodes a saved trace into register and field names
+void write_trace_tool(FILE* ofile, std::string lib_header, const char* revision);